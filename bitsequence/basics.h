@@ -55,6 +55,12 @@ using namespace std;
 /** 2W*/
 #define WW 64
 
+/** number of bits in a 64-bit word */
+#define W64 64
+
+/** W64-1 */
+#define W64minusone 63
+
 /** number of bits per uchar */
 #define bitsM 8
 
@@ -225,10 +231,14 @@ inline uint get_field4(uint *A, uint index) {
   return (A[i] << (28-j)) >> (28);
 }
 
-/** Counts the number of 1s in x */
+/** Counts the number of 1s in x (POPCNT when available) */
 inline uint popcount(int x){
+#ifdef __POPCNT__
+  return __builtin_popcount((uint)x);
+#else
   return __popcount_tab[(x >>  0) & 0xff]  + __popcount_tab[(x >>  8) & 0xff]
           + __popcount_tab[(x >> 16) & 0xff] + __popcount_tab[(x >> 24) & 0xff];
+#endif
 }
 
 /** Counts the number of 1s in the first 16 bits of x */
@@ -241,5 +251,32 @@ inline uint popcount8(int x){
   return __popcount_tab[x & 0xff];
 }
 
+/** Counts the number of 1s in the 64-bit word x (POPCNT when available) */
+inline uint popcount64(unsigned long long x){
+  return __builtin_popcountll(x);
+}
+
+/** Position of the least significant 1 in x, x must be non zero (TZCNT/BSF) */
+inline uint tzcnt64(unsigned long long x){
+  return __builtin_ctzll(x);
+}
+
+/** Position of the most significant 1 in x, x must be non zero (LZCNT/BSR) */
+inline uint msb64(unsigned long long x){
+  return W64minusone-__builtin_clzll(x);
+}
+
+/** Position of the r-th 1 (r>=1) in the 64-bit word x, x must have at least r ones */
+inline uint select64(unsigned long long x, uint r){
+#ifdef __BMI2__
+  return __builtin_ctzll(__builtin_ia32_pdep_di(1ULL<<(r-1),x));
+#else
+  uint pos=0, c;
+  while ((c=__popcount_tab[x & 0xff]) < r) { r-=c; x>>=8; pos+=8; }
+  while (--r) x&=x-1;
+  return pos+__builtin_ctzll(x);
+#endif
+}
+
 #endif	/* _BASICS_H */
 
@@ -0,0 +1,112 @@
+/* bitcount.cpp
+ * Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+ *
+ * Block popcount and prefix sum kernels used to build the rank directories.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "bitcount.h"
+
+#ifdef __AVX2__
+/* popcount of each byte of v (nibble lookup, Mula et al.) */
+static inline __m256i popcount_bytes(__m256i v){
+  const __m256i lookup=_mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                        0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+  const __m256i low=_mm256_set1_epi8(0x0f);
+  __m256i lo=_mm256_and_si256(v,low);
+  __m256i hi=_mm256_and_si256(_mm256_srli_epi16(v,4),low);
+  return _mm256_add_epi8(_mm256_shuffle_epi8(lookup,lo),_mm256_shuffle_epi8(lookup,hi));
+}
+
+static inline __m256i load8(const uint *A){
+  return _mm256_loadu_si256((const __m256i*)A);
+}
+#endif
+
+uint popcount_words(const uint *A, uint n){
+  uint i=0;
+  unsigned long long acc=0;
+#ifdef __AVX2__
+  const __m256i zero=_mm256_setzero_si256();
+  __m256i total=zero;
+  //byte counters hold at most 4*8=32, so 4 vectors are added before the sad
+  for(;i+32<=n;i+=32){
+    __m256i local=popcount_bytes(load8(A+i));
+    local=_mm256_add_epi8(local,popcount_bytes(load8(A+i+8)));
+    local=_mm256_add_epi8(local,popcount_bytes(load8(A+i+16)));
+    local=_mm256_add_epi8(local,popcount_bytes(load8(A+i+24)));
+    total=_mm256_add_epi64(total,_mm256_sad_epu8(local,zero));
+  }
+  for(;i+8<=n;i+=8)
+    total=_mm256_add_epi64(total,_mm256_sad_epu8(popcount_bytes(load8(A+i)),zero));
+  acc=(unsigned long long)_mm256_extract_epi64(total,0)+_mm256_extract_epi64(total,1)
+     +_mm256_extract_epi64(total,2)+_mm256_extract_epi64(total,3);
+#endif
+  for(;i+2<=n;i+=2)
+    acc+=popcount64((unsigned long long)A[i] | ((unsigned long long)A[i+1]<<W));
+  if(i<n)
+    acc+=popcount(A[i]);
+  return (uint)acc;
+}
+
+uint popcount_bits(const uint *A, uint from, uint to){
+  if(from>to) return 0;
+  uint fw=from/W, tw=to/W;
+  uint lmask=~0u<<(from%W), rmask=~0u>>(Wminusone-to%W);
+  if(fw==tw) return popcount(A[fw]&lmask&rmask);
+  return popcount(A[fw]&lmask)+popcount_words(A+fw+1,tw-fw-1)+popcount(A[tw]&rmask);
+}
+
+void block_prefix_popcounts(const uint *A, uint nwords, uint block, uint nblocks, uint *R){
+  R[0]=0;
+  if(nblocks==0) return;
+  uint *counts=R+1;
+  for(uint j=0;j<nblocks;j++){
+    uint ini=j*block;
+    counts[j] = ini<nwords ? popcount_words(A+ini,min(block,nwords-ini)) : 0;
+  }
+  prefix_sum(counts,nblocks,0);
+}
+
+void prefix_sum(uint *V, uint n, uint init){
+  uint i=0;
+#ifdef __AVX2__
+  __m256i carry=_mm256_set1_epi32(init);
+  const __m256i zero=_mm256_setzero_si256();
+  const __m256i idx3=_mm256_set1_epi32(3), idx7=_mm256_set1_epi32(7);
+  for(;i+8<=n;i+=8){
+    __m256i x=load8(V+i);
+    //scan inside each 128-bit lane
+    x=_mm256_add_epi32(x,_mm256_slli_si256(x,4));
+    x=_mm256_add_epi32(x,_mm256_slli_si256(x,8));
+    //carry the low lane total into the high lane
+    x=_mm256_add_epi32(x,_mm256_blend_epi32(zero,_mm256_permutevar8x32_epi32(x,idx3),0xF0));
+    x=_mm256_add_epi32(x,carry);
+    _mm256_storeu_si256((__m256i*)(V+i),x);
+    carry=_mm256_permutevar8x32_epi32(x,idx7);
+  }
+#endif
+  uint acc = i ? V[i-1] : init;
+  for(;i<n;i++){
+    acc+=V[i];
+    V[i]=acc;
+  }
+}
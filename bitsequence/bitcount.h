@@ -0,0 +1,44 @@
+/* bitcount.h
+ * Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+ *
+ * Block popcount and prefix sum kernels used to build the rank directories.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _BITCOUNT_H
+#define	_BITCOUNT_H
+
+#include <basics.h>
+
+/* All the kernels use AVX2 when the compiler targets it (__AVX2__, e.g.
+ * make CPPFLAGS+=-march=native) and fall back to scalar POPCNT otherwise.
+ * Arrays of 64-bit words can be passed as uint arrays of twice the length. */
+
+/** Counts the number of 1s in the n words of A */
+uint popcount_words(const uint *A, uint n);
+
+/** Counts the number of 1s of A in the bit positions [from,to] */
+uint popcount_bits(const uint *A, uint from, uint to);
+
+/** Stores in R[j] the number of 1s in the first j blocks of block words of A,
+ *  for j=0..nblocks. Words at or beyond nwords are taken as 0 */
+void block_prefix_popcounts(const uint *A, uint nwords, uint block, uint nblocks, uint *R);
+
+/** In-place inclusive prefix sum of the n values of V, starting from init */
+void prefix_sum(uint *V, uint n, uint init);
+
+#endif	/* _BITCOUNT_H */
@@ -79,6 +79,47 @@ bool static_bitsequence::access(uint i) {
   return (rank1(i)-(i!=0?rank1(i-1):0))>0;
 }
 
+uint static_bitsequence::select1_next(uint p, uint r, uint x) {
+  return select1(x);
+}
+
+uint static_bitsequence::select0_next(uint p, uint r, uint x) {
+  return select0(x);
+}
+
+uint static_bitsequence::popcount_range(uint from, uint to) {
+  if(from>to) return 0;
+  return rank1(to)-(from!=0?rank1(from-1):0);
+}
+
+void static_bitsequence::rank1_batch(const uint *I, uint n, uint *out) {
+  for(uint k=0;k<n;k++)
+    out[k]=rank1(I[k]);
+}
+
+void static_bitsequence::select1_batch(const uint *X, uint n, uint *out) {
+  for(uint k=0;k<n;k++)
+    out[k]=select1(X[k]);
+}
+
+void static_bitsequence::access_batch(const uint *I, uint n, bool *out) {
+  for(uint k=0;k<n;k++)
+    out[k]=access(I[k]);
+}
+
+void static_bitsequence::get_bitmap(uint *bitmap) {
+  for(uint k=0;k<uint_len(len,1);k++)
+    bitmap[k]=0;
+  for(uint i=0;i<len;i++)
+    if(access(i)) bitset(bitmap,i);
+}
+
+bool static_bitsequence::is_sorted(const uint *A, uint n) {
+  for(uint k=1;k<n;k++)
+    if(A[k]<A[k-1]) return false;
+  return true;
+}
+
 uint static_bitsequence::length() {
 	return len;
 }
@@ -91,6 +132,30 @@ uint static_bitsequence::count_zero() {
 	return len-ones;
 }
 
+unsigned long long static_bitsequence64::rank0(unsigned long long i) {
+  return i+1-rank1(i);
+}
+
+unsigned long long static_bitsequence64::select1_next(unsigned long long p, unsigned long long r, unsigned long long x) {
+  return select1(x);
+}
+
+unsigned long long static_bitsequence64::select0_next(unsigned long long p, unsigned long long r, unsigned long long x) {
+  return select0(x);
+}
+
+unsigned long long static_bitsequence64::length() {
+  return len;
+}
+
+unsigned long long static_bitsequence64::count_one() {
+  return ones;
+}
+
+unsigned long long static_bitsequence64::count_zero() {
+  return len-ones;
+}
+
 static_bitsequence * static_bitsequence::load(FILE * fp) {
   uint r;
   if(fread(&r,sizeof(uint),1,fp)!=1) return NULL;
@@ -99,6 +164,10 @@ static_bitsequence * static_bitsequence::load(FILE * fp) {
     case RRR02_HDR: return static_bitsequence_rrr02::load(fp);
     case BRW32_HDR: return static_bitsequence_brw32::load(fp);
     case RRR02_LIGHT_HDR: return static_bitsequence_rrr02_light::load(fp);
+    case BRW64_HDR: return static_bitsequence_brw64::load(fp);
+    case INTERLEAVED_HDR: return static_bitsequence_interleaved::load(fp);
+    case ELIASFANO_HDR: return static_bitsequence_eliasfano::load(fp);
+    case RRR63_HDR: return static_bitsequence_rrr63::load(fp);
   }
   return NULL;
 }
@@ -25,6 +25,18 @@
 #define RRR02_HDR 2
 #define BRW32_HDR 3
 #define RRR02_LIGHT_HDR 4
+#define BRW64_HDR 5
+#define INTERLEAVED_HDR 6
+#define ELIASFANO_HDR 7
+#define RRR63_HDR 8
+#define BRW64_LARGE_HDR 9
+
+/** queries looked ahead (prefetched) by the batched calls */
+#define BATCH_PREFETCH 8
+/** lookups run in lockstep by the batched binary searches */
+#define BATCH_GROUP 16
+/** words scanned forward by select1_next/select0_next before a select */
+#define NEXT_WORDS 8
 
 #include <basics.h>
 #include <iostream>
@@ -41,6 +53,9 @@ using namespace std;
 class static_bitsequence {
 
 public:
+  /** Type of the positions */
+  typedef uint index_type;
+
   virtual ~static_bitsequence() {};
 
 	/** Returns the number of zeros until position i */
@@ -60,6 +75,27 @@ public:
 	/** Returns the i-th bit */
   virtual bool access(uint i);
 
+	/** Returns select1(x) (select0(x)) knowing that position p<select1(x) has
+	 *  r=rank1(p) (r=rank0(p)), so cursors moving forward can scan from p */
+  virtual uint select1_next(uint p, uint r, uint x);
+  virtual uint select0_next(uint p, uint r, uint x);
+
+	/** Returns the number of ones in positions [from,to] */
+  virtual uint popcount_range(uint from, uint to);
+
+	/** Stores in out[k] the result of rank1(I[k]), for k<n */
+  virtual void rank1_batch(const uint *I, uint n, uint *out);
+
+	/** Stores in out[k] the result of select1(X[k]), for k<n */
+  virtual void select1_batch(const uint *X, uint n, uint *out);
+
+	/** Stores in out[k] the result of access(I[k]), for k<n */
+  virtual void access_batch(const uint *I, uint n, bool *out);
+
+	/** Writes the len bits of the bitstring into bitmap (uint_len(len,1) words),
+	 *  the bits of the last word beyond len are zero */
+  virtual void get_bitmap(uint *bitmap);
+
 	/** Returns the length in bits of the bitmap */
   virtual uint length();
 
@@ -79,6 +115,9 @@ public:
   static static_bitsequence * load(FILE * fp);
 
 protected:
+	/** Returns true if the n values of A are in non decreasing order */
+  static bool is_sorted(const uint *A, uint n);
+
 	/** Length of the bitstring */
   uint len;
 	/** Number of ones in the bitstring */
@@ -86,9 +125,50 @@ protected:
 
 };
 
+/** Base class for bitsequences of more than 2^32 bits: the queries of
+ *  static_bitsequence over 64-bit positions. Only the ones used by the
+ *  wavelet trees of 64-bit positions are declared.
+ *
+ *  @author Carlos Bedregal
+ */
+class static_bitsequence64 {
+
+public:
+  typedef unsigned long long index_type;
+
+  virtual ~static_bitsequence64() {};
+
+  virtual unsigned long long rank0(unsigned long long i);
+  virtual unsigned long long rank1(unsigned long long i)=0;
+  virtual unsigned long long select0(unsigned long long x)=0;
+  virtual unsigned long long select1(unsigned long long x)=0;
+  virtual bool access(unsigned long long i)=0;
+  virtual unsigned long long select1_next(unsigned long long p, unsigned long long r, unsigned long long x);
+  virtual unsigned long long select0_next(unsigned long long p, unsigned long long r, unsigned long long x);
+  virtual void get_bitmap(uint *bitmap)=0;
+  virtual unsigned long long length();
+  virtual unsigned long long count_one();
+  virtual unsigned long long count_zero();
+  virtual unsigned long long size()=0;
+  virtual int save(FILE * fp)=0;
+
+protected:
+  unsigned long long len;
+  unsigned long long ones;
+};
+
+/** Interface of the bitsequences over positions of type I */
+template<class I> struct static_bitsequence_of;
+template<> struct static_bitsequence_of<uint> { typedef static_bitsequence type; };
+template<> struct static_bitsequence_of<unsigned long long> { typedef static_bitsequence64 type; };
+
 #include <static_bitsequence_rrr02.h>
 #include <static_bitsequence_rrr02_light.h>
 #include <static_bitsequence_naive.h>
 #include <static_bitsequence_brw32.h>
+#include <static_bitsequence_brw64.h>
+#include <static_bitsequence_interleaved.h>
+#include <static_bitsequence_eliasfano.h>
+#include <static_bitsequence_rrr63.h>
 
 #endif	/* _STATIC_BITSEQUENCE_H */
@@ -20,6 +20,7 @@
 */
 
 #include "static_bitsequence_brw32.h"
+#include "bitcount.h"
 #include <cassert>
 #include <cmath>
 // #include <sys/types.h>
@@ -38,12 +39,16 @@
 
 static_bitsequence_brw32::static_bitsequence_brw32(){
   data=NULL;
-//  this->owner = true;
+  Rs=NULL;
+  sel_sample=0;
+  Ss1=Ss0=NULL;
+  nsel1=nsel0=0;
+  this->owner = true;
   this->len=0;
   //this->factor=0;
 }
 
-static_bitsequence_brw32::static_bitsequence_brw32( uint *bitarray, uint _n, uint _factor){
+static_bitsequence_brw32::static_bitsequence_brw32( uint *bitarray, uint _n, uint _factor, uint _sel_sample, bool _owner){
   /*cout << "*****" << endl;
   cout << bitarray << endl;
   cout << _n << endl;
@@ -51,12 +56,15 @@ static_bitsequence_brw32::static_bitsequence_brw32( uint *bitarray, uint _n, uin
 	this->len = _n;
 	this->ones = len/W+1;
   if(_factor==0) exit(-1);
-  data=new uint[_n/W+1];
-  for(uint i=0;i<uint_len(_n,1);i++)
-    data[i] = bitarray[i];
-  for(uint i=uint_len(_n,1);i<_n/W+1;i++)
-    data[i] = 0;
-  //this->owner = true;
+  this->owner = _owner;
+  if(owner){
+    data=new uint[_n/W+1];
+    for(uint i=0;i<uint_len(_n,1);i++)
+      data[i] = bitarray[i];
+    for(uint i=uint_len(_n,1);i<_n/W+1;i++)
+      data[i] = 0;
+  }
+  else data=bitarray;
   //this->n=_n;
   //uint lgn=bits(len-1);
   //this->factor=_factor;
@@ -66,12 +74,17 @@ static_bitsequence_brw32::static_bitsequence_brw32( uint *bitarray, uint _n, uin
   //s=b*this->factor;
   //integers = n/W+1;
   BuildRank();
-
+  sel_sample=0;
+  Ss1=Ss0=NULL;
+  nsel1=nsel0=0;
+  create_select_sampling(_sel_sample);
 }
 
 static_bitsequence_brw32::~static_bitsequence_brw32() {
   delete [] Rs;
-  delete [] data;
+  if(owner) delete [] data;
+  delete [] Ss1;
+  delete [] Ss0;
 }
 
 //Metodo que realiza la busqueda d
@@ -80,24 +93,40 @@ void static_bitsequence_brw32::BuildRank(){
   Rs = new uint[num_sblock+5];// +1 pues sumo la pos cero
   for(uint i=0;i<num_sblock+5;i++)
     Rs[i]=0;
-  uint j;
-  Rs[0]=0;
-  for (j=1;j<=num_sblock;j++) {
-    Rs[j]=Rs[j-1];
-    Rs[j]+=BuildRankSub((j-1)*FACTOR,FACTOR);
-  }
+  //Rs[j] = number of 1's in the first j superblocks (this->ones = #words)
+  block_prefix_popcounts(data,this->ones,FACTOR,num_sblock,Rs);
 }
 
-uint static_bitsequence_brw32::BuildRankSub(uint ini,uint bloques){
-  uint rank=0,aux;
-  for(uint i=ini;i<ini+bloques;i++) {
-    if (i < this->ones) {
-      aux=data[i];
-      rank+=popcount(aux);
-    }
+void static_bitsequence_brw32::create_select_sampling(uint _sel_sample){
+  delete [] Ss1;
+  delete [] Ss0;
+  Ss1=Ss0=NULL;
+  nsel1=nsel0=0;
+  sel_sample=_sel_sample;
+  if(sel_sample==0) return;
+
+  uint nsb=len/S; //last superblock
+  uint n1=rank1(len-1), n0=len-n1;
+  //Ss1[k] = last superblock j with Rs[j] < k*sel_sample+1
+  nsel1=(n1+sel_sample-1)/sel_sample;
+  Ss1=new uint[nsel1+1];
+  uint j=0;
+  for(uint k=0;k<nsel1;k++){
+    uint x=k*sel_sample+1;
+    while(j<nsb && Rs[j+1]<x) j++;
+    Ss1[k]=j;
   }
-  return rank; //retorna el numero de 1's del intervalo
-
+  Ss1[nsel1]=nsb;
+  //Ss0[k] = last superblock j with j*S-Rs[j] < k*sel_sample+1
+  nsel0=(n0+sel_sample-1)/sel_sample;
+  Ss0=new uint[nsel0+1];
+  j=0;
+  for(uint k=0;k<nsel0;k++){
+    uint x=k*sel_sample+1;
+    while(j<nsb && (j+1)*S-Rs[j+1]<x) j++;
+    Ss0[k]=j;
+  }
+  Ss0[nsel0]=nsb;
 }
 
 uint static_bitsequence_brw32::rank1(uint i) {
@@ -114,6 +143,136 @@ bool static_bitsequence_brw32::access(uint i) {
   return (1u << (i % W)) & data[i/W];
 }
 
+void static_bitsequence_brw32::rank1_batch(const uint *I, uint n, uint *out) {
+  if (is_sorted(I,n)) {
+    //the count of the previous query is extended while the next one falls
+    //in the same superblock
+    uint sb=(uint)-1, w=0, acc=0;
+    for (uint k=0;k<n;k++) {
+      uint i=I[k]+1;
+      if (i/S!=sb) {
+        sb=i/S;
+        acc=Rs[sb];
+        w=sb*FACTOR;
+      }
+      for (;w<i/W;w++)
+        acc+=popcount(data[w]);
+      out[k]=acc+popcount(data[i/W] & ((1u<<(i & mask31))-1));
+    }
+    return;
+  }
+  for (uint k=0;k<n;k++) {
+    if (k+BATCH_PREFETCH<n) {
+      uint i=I[k+BATCH_PREFETCH]+1;
+      __builtin_prefetch(Rs+i/S);
+      __builtin_prefetch(data+i/W);
+    }
+    out[k]=static_bitsequence_brw32::rank1(I[k]);
+  }
+}
+
+void static_bitsequence_brw32::select1_batch(const uint *X, uint n, uint *out) {
+  uint nsb=len/S, n1=len ? static_bitsequence_brw32::rank1(len-1) : 0;
+  if (is_sorted(X,n)) {
+    //sb only moves forward: gallop from the superblock of the previous query
+    uint sb=0;
+    for (uint k=0;k<n;k++) {
+      uint x=X[k];
+      if (x==0 || x>n1) {
+        out[k]=x ? len : (uint)-1;
+        continue;
+      }
+      if (sel_sample && Ss1[(x-1)/sel_sample]>sb)
+        sb=Ss1[(x-1)/sel_sample];
+      uint step=1;
+      while (sb+step<=nsb && Rs[sb+step]<x) {
+        sb+=step;
+        step*=2;
+      }
+      uint r=min(sb+step,nsb+1);
+      while (sb+1<r) {
+        uint mid=(sb+r)/2;
+        if (Rs[mid]<x) sb=mid;
+        else r=mid;
+      }
+      out[k]=select1_in(sb,x);
+    }
+    return;
+  }
+  //lockstep binary searches over Rs, each step prefetches the next probe
+  uint lo[BATCH_GROUP], hi[BATCH_GROUP];
+  for (uint base=0;base<n;base+=BATCH_GROUP) {
+    uint m=min((uint)BATCH_GROUP,n-base);
+    for (uint j=0;j<m;j++) {
+      uint x=X[base+j];
+      lo[j]=0; hi[j]=0;
+      if (x==0 || x>n1) continue;
+      if (sel_sample) {
+        lo[j]=Ss1[(x-1)/sel_sample];
+        hi[j]=Ss1[(x-1)/sel_sample+1];
+      }
+      else hi[j]=nsb;
+      __builtin_prefetch(Rs+(lo[j]+hi[j]+1)/2);
+    }
+    bool active=true;
+    while (active) {
+      active=false;
+      for (uint j=0;j<m;j++) {
+        if (lo[j]>=hi[j]) continue;
+        uint mid=(lo[j]+hi[j]+1)/2;
+        if (Rs[mid]<X[base+j]) lo[j]=mid;
+        else hi[j]=mid-1;
+        __builtin_prefetch(Rs+(lo[j]+hi[j]+1)/2);
+        active=true;
+      }
+    }
+    for (uint j=0;j<m;j++) {
+      uint x=X[base+j];
+      if (x==0 || x>n1) out[base+j]=x ? len : (uint)-1;
+      else out[base+j]=select1_in(lo[j],x);
+    }
+  }
+}
+
+uint static_bitsequence_brw32::select1_next(uint p, uint r, uint x) {
+  //popcount over the words after p, select1 if the x-th one is further
+  uint need=x-r, w=(p+1)/W;
+  uint word=data[w] & (~0u<<((p+1)%W));
+  for (uint k=0;k<NEXT_WORDS && w<this->ones;k++) {
+    uint c=popcount(word);
+    if (c>=need) return w*W+select64(word,need);
+    need-=c;
+    if (++w<this->ones) word=data[w];
+  }
+  return static_bitsequence_brw32::select1(x);
+}
+
+uint static_bitsequence_brw32::select0_next(uint p, uint r, uint x) {
+  uint need=x-r, w=(p+1)/W;
+  uint word=~data[w] & (~0u<<((p+1)%W));
+  for (uint k=0;k<NEXT_WORDS && w<this->ones;k++) {
+    uint c=popcount(word);
+    if (c>=need) return w*W+select64(word,need);
+    need-=c;
+    if (++w<this->ones) word=~data[w];
+  }
+  return static_bitsequence_brw32::select0(x);
+}
+
+void static_bitsequence_brw32::get_bitmap(uint *bitmap) {
+  for (uint k=0;k<uint_len(len,1);k++)
+    bitmap[k]=data[k];
+  if (len%W) bitmap[len/W] &= (1u<<(len%W))-1;
+}
+
+void static_bitsequence_brw32::access_batch(const uint *I, uint n, bool *out) {
+  for (uint k=0;k<n;k++) {
+    if (k+BATCH_PREFETCH<n)
+      __builtin_prefetch(data+I[k+BATCH_PREFETCH]/W);
+    out[k]=(1u << (I[k] % W)) & data[I[k]/W];
+  }
+}
+
 int static_bitsequence_brw32::save(FILE *f) {
   //uint wr = BRW32_HDR;
   if (f == NULL) return 20;
@@ -147,11 +306,13 @@ static_bitsequence_brw32 * static_bitsequence_brw32::load(FILE *f) {
   if (!ret->Rs) return NULL;
   if (fread (ret->Rs,sizeof(uint),ret->len/S+1,f) != ret->len/S+1) return NULL;	//(5)
 	ret->len = ret->len;
+  //the select sampling is not stored, see create_select_sampling()
   return ret;
 }
 
 uint static_bitsequence_brw32::SpaceRequirementInBits() {
-  return uint_len(len,1)*sizeof(uint)*8+(len/S)*sizeof(uint)*8;
+  uint sampling = sel_sample ? (nsel1+1+nsel0+1)*sizeof(uint)*8 : 0;
+  return uint_len(len,1)*sizeof(uint)*8+(len/S)*sizeof(uint)*8+sampling;
 }
 
 uint static_bitsequence_brw32::size() {
@@ -159,7 +320,8 @@ uint static_bitsequence_brw32::size() {
 }
 
 uint static_bitsequence_brw32::SpaceRequirement() {
-  return len/8+(len/S)*sizeof(uint)+sizeof(static_bitsequence_brw32);
+  uint sampling = sel_sample ? (nsel1+1+nsel0+1)*sizeof(uint) : 0;
+  return len/8+(len/S)*sizeof(uint)+sampling+sizeof(static_bitsequence_brw32);
 }
 
 uint static_bitsequence_brw32::prev2(uint start) {
@@ -239,8 +401,14 @@ uint static_bitsequence_brw32::select1(uint x) {
   // then sequential search using popcount over a char
   // then sequential search bit a bit
 
-  //binary search over first level rank structure
+  //binary search over first level rank structure, restricted to the
+  //superblocks between two select samples when the sampling exists
   uint l=0, r=len/S;
+  if (sel_sample && x) {
+    uint k=(x-1)/sel_sample;
+    if (k>=nsel1) return len;
+    l=Ss1[k]; r=Ss1[k+1];
+  }
   uint mid=(l+r)/2;
   uint rankmid = Rs[mid];
   while (l<=r) {
@@ -251,10 +419,16 @@ uint static_bitsequence_brw32::select1(uint x) {
     mid = (l+r)/2;
     rankmid = Rs[mid];
   }
+  return select1_in(mid,x);
+}
+
+uint static_bitsequence_brw32::select1_in(uint sb, uint x) {
+  // select1 once the superblock sb holding the x-th one is known
   //sequential search using popcount over a int
   uint left;
-  left=mid*FACTOR;
-  x-=rankmid;
+  left=sb*FACTOR;
+  x-=Rs[sb];
+  uint rankmid;
         uint j=data[left];
         uint ones = popcount(j);
         while (ones < x) {
@@ -300,9 +474,15 @@ uint static_bitsequence_brw32::select0(uint x) {
   // then sequential search using popcount over a char
   // then sequential search bit a bit
 
-  //binary search over first level rank structure
+  //binary search over first level rank structure, restricted to the
+  //superblocks between two select samples when the sampling exists
   if(x==0) return 0;
   uint l=0, r=len/S;
+  if (sel_sample) {
+    uint k=(x-1)/sel_sample;
+    if (k>=nsel0) return len;
+    l=Ss0[k]; r=Ss0[k+1];
+  }
   uint mid=(l+r)/2;
   uint rankmid = mid*FACTOR*W-Rs[mid];
   while (l<=r) {
@@ -39,6 +39,14 @@
 #define B 32
 #define S 640 //B*20
 
+/////////////////
+//Select(B,x)  //
+/////////////////
+//a sample every SELECT_SAMPLING ones (and zeros) stores the superblock where
+//it lies, so select only binary searches Rs between two consecutive samples.
+//0 disables the sampling. Overhead ~ 2*32/SELECT_SAMPLING bits per bit
+#define SELECT_SAMPLING 1024
+
 /** Implementation of Rodrigo Gonzalez et al. practical rank/select solution [1]. 
  *  The interface was adapted.
  *  
@@ -51,19 +59,27 @@
 class static_bitsequence_brw32 : public static_bitsequence {
 private:
 	uint *data;
-  //bool owner;
+  bool owner; //data was allocated here, false if it belongs to the caller
 	//uint n;//,integers=len/W+1;
 	//uint factor=20;//,b=32,s=20*32;
   uint *Rs; //superblock array
+  uint sel_sample; //ones (zeros) between select samples, 0=no sampling
+  uint *Ss1, *Ss0; //superblock of every sel_sample-th one (zero)
+  uint nsel1, nsel0; //number of samples in Ss1 and Ss0 (without sentinel)
 
-	uint BuildRankSub(uint ini,uint fin); //uso interno para contruir el indice rank
 	void BuildRank(); //crea indice para rank
   static_bitsequence_brw32();
+  uint select1_in(uint sb, uint x); //select1 inside superblock sb
   
 public:
-  static_bitsequence_brw32(uint *bitarray, uint n, uint factor);
+  /** owner=false keeps bitarray (n/W+1 words, bits from n on zero) as the
+   *  bitmap instead of copying it, the caller frees it after this object */
+  static_bitsequence_brw32(uint *bitarray, uint n, uint factor, uint sel_sample=0, bool owner=true);
   ~static_bitsequence_brw32(); //destructor
   virtual bool access(uint i);
+  virtual uint select1_next(uint p, uint r, uint x);
+  virtual uint select0_next(uint p, uint r, uint x);
+  virtual void get_bitmap(uint *bitmap);
   virtual uint rank1(uint i); //Nivel 1 bin, nivel 2 sec-pop y nivel 3 sec-bit
 
   uint prev(uint start); // gives the largest index i<=start such that IsBitSet(i)=true
@@ -71,9 +87,20 @@ public:
   uint next(uint start); // gives the smallest index i>=start such that IsBitSet(i)=true
   virtual uint select0(uint x); // gives the position of the x:th 1.
   virtual uint select1(uint x); // gives the position of the x:th 1.
+
+  /** Batched queries: sorted inputs are answered with a sequential scan of
+   *  the directory; otherwise independent lookups are prefetched ahead
+   *  (rank, access) or binary searched in lockstep (select) */
+  virtual void rank1_batch(const uint *I, uint n, uint *out);
+  virtual void select1_batch(const uint *X, uint n, uint *out);
+  virtual void access_batch(const uint *I, uint n, bool *out);
   uint SpaceRequirementInBits();
   uint SpaceRequirement();
   virtual uint size();
+
+  /** Creates (or replaces) the select sampling, one sample every sel_sample
+   *  ones and zeros. sel_sample=0 removes the sampling */
+  void create_select_sampling(uint sel_sample);
   
   /*load-save functions*/
   virtual int save(FILE *f);
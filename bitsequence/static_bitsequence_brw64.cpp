@@ -0,0 +1,268 @@
+/* static_bitsequence_brw64.cpp
+   Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+
+   RANK and SELECT over 64-bit words using hardware popcount.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "static_bitsequence_brw64.h"
+#include "bitcount.h"
+#include <cassert>
+
+/* R[j]: ones in the first j superblocks of factor words of data, for
+ * j=0..nblocks. The 32-bit counters use the kernels of bitcount.h, counting
+ * the 64-bit words as pairs of 32-bit words */
+static void superblock_counts(const unsigned long long *data, uint nwords, uint factor, uint nblocks, uint *R) {
+  block_prefix_popcounts((const uint *)data,2*nwords,2*factor,nblocks,R);
+}
+
+static void superblock_counts(const unsigned long long *data, unsigned long long nwords, uint factor,
+                              unsigned long long nblocks, unsigned long long *R) {
+  unsigned long long acc=0;
+  for(unsigned long long j=0;j<=nblocks;j++){
+    R[j]=acc;
+    for(unsigned long long w=j*factor;w<(j+1)*factor && w<nwords;w++)
+      acc+=popcount64(data[w]);
+  }
+}
+
+template<class I>
+basic_static_bitsequence_brw64<I>::basic_static_bitsequence_brw64(){
+  data=NULL;
+  Rs=NULL;
+  this->len=0;
+  this->ones=0;
+  factor=FACTOR64;
+  fbits=bits(FACTOR64-1);
+  nwords=nsblocks=0;
+}
+
+template<class I>
+basic_static_bitsequence_brw64<I>::basic_static_bitsequence_brw64(uint *bitarray, I _n, uint _factor){
+  if(_factor==0) exit(-1);
+  this->len=_n;
+  fbits=bits(_factor-1);
+  factor=1<<fbits;
+  nwords=this->len/W64+1;
+  data=new unsigned long long[nwords];
+  I n32=(this->len+W-1)/W;
+  for(I i=0;i<nwords;i++){
+    unsigned long long lo = (2*i<n32) ? bitarray[2*i] : 0;
+    unsigned long long hi = (2*i+1<n32) ? bitarray[2*i+1] : 0;
+    data[i] = lo | (hi<<W);
+  }
+  //clean the bits beyond len, so the counters do not see garbage
+  data[this->len/W64] &= (1ULL<<(this->len%W64))-1;
+  BuildRank();
+}
+
+template<class I>
+I basic_static_bitsequence_brw64<I>::select1_next(I p, I r, I x) {
+  //popcount over the words after p, select1 if the x-th one is further
+  I need=x-r, w=(p+1)/W64;
+  unsigned long long word=data[w] & (~0ULL<<((p+1)%W64));
+  for(uint k=0;k<NEXT_WORDS && w<nwords;k++){
+    uint c=popcount64(word);
+    if(c>=need) return w*W64+select64(word,need);
+    need-=c;
+    if(++w<nwords) word=data[w];
+  }
+  return basic_static_bitsequence_brw64::select1(x);
+}
+
+template<class I>
+I basic_static_bitsequence_brw64<I>::select0_next(I p, I r, I x) {
+  I need=x-r, w=(p+1)/W64;
+  unsigned long long word=~data[w] & (~0ULL<<((p+1)%W64));
+  for(uint k=0;k<NEXT_WORDS && w<nwords;k++){
+    uint c=popcount64(word);
+    if(c>=need) return w*W64+select64(word,need);
+    need-=c;
+    if(++w<nwords) word=~data[w];
+  }
+  return basic_static_bitsequence_brw64::select0(x);
+}
+
+template<class I>
+void basic_static_bitsequence_brw64<I>::get_bitmap(uint *bitmap) {
+  I n32=(this->len+W-1)/W;
+  for(I k=0;k<n32;k++)
+    bitmap[k]=(uint)(data[k/2]>>(W*(k%2)));
+}
+
+template<class I>
+basic_static_bitsequence_brw64<I>::~basic_static_bitsequence_brw64() {
+  delete [] Rs;
+  delete [] data;
+}
+
+template<class I>
+void basic_static_bitsequence_brw64<I>::BuildRank(){
+  nsblocks = (nwords>>fbits)+1;
+  Rs = new I[nsblocks];
+  superblock_counts(data,nwords,factor,nsblocks-1,Rs);
+  I last=(nsblocks-1)<<fbits;
+  this->ones=Rs[nsblocks-1];
+  for(I w=last;w<nwords;w++)
+    this->ones+=popcount64(data[w]);
+}
+
+template<class I>
+I basic_static_bitsequence_brw64<I>::rank1(I i) {
+  if(i>=this->len) return this->ones;
+  ++i;
+  I w=i/W64;
+  I resp=Rs[w>>fbits];
+  for (I a=(w>>fbits)<<fbits;a<w;a++)
+    resp+=popcount64(data[a]);
+  resp+=popcount64(data[w] & ((1ULL<<(i%W64))-1));
+  return resp;
+}
+
+template<class I>
+I basic_static_bitsequence_brw64<I>::rank0(I i) {
+  if(i>=this->len) return this->len-this->ones;
+  return i+1-rank1(i);
+}
+
+template<class I>
+bool basic_static_bitsequence_brw64<I>::access(I i) {
+  return (data[i/W64] >> (i%W64)) & 1;
+}
+
+template<class I>
+I basic_static_bitsequence_brw64<I>::select1(I x) {
+  // returns i such that x=rank(i) && rank(i-1)<x or n if that i not exist
+  // first binary search over the superblocks, then sequential popcount over
+  // the words of the superblock, then select inside the word
+  if(x==0) return (I)-1;
+  if(x>this->ones) return this->len;
+  I l=0, r=nsblocks-1;
+  while (l<r) {
+    I mid=(l+r+1)/2;
+    if (Rs[mid]<x) l=mid;
+    else r=mid-1;
+  }
+  x-=Rs[l];
+  I w=l<<fbits;
+  uint cnt=popcount64(data[w]);
+  while (cnt<x) {
+    x-=cnt;
+    cnt=popcount64(data[++w]);
+  }
+  return w*W64+select64(data[w],x);
+}
+
+template<class I>
+I basic_static_bitsequence_brw64<I>::select0(I x) {
+  // returns i such that x=rank_0(i) && rank_0(i-1)<x or n if that i not exist
+  if(x==0) return (I)-1;
+  if(x>this->len-this->ones) return this->len;
+  I l=0, r=nsblocks-1;
+  while (l<r) {
+    I mid=(l+r+1)/2;
+    if ((mid<<fbits)*W64-Rs[mid]<x) l=mid;
+    else r=mid-1;
+  }
+  x-=(l<<fbits)*W64-Rs[l];
+  I w=l<<fbits;
+  uint cnt=W64-popcount64(data[w]);
+  while (cnt<x) {
+    x-=cnt;
+    cnt=W64-popcount64(data[++w]);
+  }
+  return w*W64+select64(~data[w],x);
+}
+
+template<class I>
+I basic_static_bitsequence_brw64<I>::next(I k) {
+  if(k>=this->len) return this->len;
+  I w=k/W64;
+  unsigned long long aux=data[w] >> (k%W64);
+  if(aux) return k+tzcnt64(aux);
+  for(w++;w<nwords;w++)
+    if(data[w]) return w*W64+tzcnt64(data[w]);
+  return this->len;
+}
+
+template<class I>
+I basic_static_bitsequence_brw64<I>::prev(I start) {
+  // returns the position of the previous 1 bit before and including start.
+  I w=start/W64;
+  unsigned long long aux=data[w] & (~0ULL >> (W64minusone-start%W64));
+  if(aux) return w*W64+msb64(aux);
+  while(w>0){
+    w--;
+    if(data[w]) return w*W64+msb64(data[w]);
+  }
+  return (I)-1;
+}
+
+/* the large bitsequences have their own header, and their length and
+ * counters take 64 bits */
+template<class I>
+int basic_static_bitsequence_brw64<I>::save(FILE *f) {
+  uint wr = sizeof(I)>sizeof(uint) ? BRW64_LARGE_HDR : BRW64_HDR;
+  if (f == NULL) return 20;
+  if (fwrite (&wr,sizeof(uint),1,f) != 1) return 21;
+  if (fwrite (&this->len,sizeof(I),1,f) != 1) return 21;
+  if (fwrite (&factor,sizeof(uint),1,f) != 1) return 21;
+  if (fwrite (data,sizeof(unsigned long long),nwords,f) != nwords) return 21;
+  if (fwrite (Rs,sizeof(I),nsblocks,f) != nsblocks) return 21;
+  return 0;
+}
+
+template<class I>
+basic_static_bitsequence_brw64<I> * basic_static_bitsequence_brw64<I>::load(FILE *f) {
+  if (f == NULL) return NULL;
+  uint type;
+  uint hdr = sizeof(I)>sizeof(uint) ? BRW64_LARGE_HDR : BRW64_HDR;
+  if (fread (&type,sizeof(uint),1,f) != 1 || type != hdr) return NULL;
+  basic_static_bitsequence_brw64 * ret = new basic_static_bitsequence_brw64();
+  if (fread (&ret->len,sizeof(I),1,f) != 1 ||
+      fread (&ret->factor,sizeof(uint),1,f) != 1 || ret->factor==0) {
+    delete ret;
+    return NULL;
+  }
+  ret->fbits = bits(ret->factor-1);
+  ret->nwords = ret->len/W64+1;
+  ret->nsblocks = (ret->nwords>>ret->fbits)+1;
+  ret->data = new unsigned long long[ret->nwords];
+  ret->Rs = new I[ret->nsblocks];
+  if (fread (ret->data,sizeof(unsigned long long),ret->nwords,f) != ret->nwords ||
+      fread (ret->Rs,sizeof(I),ret->nsblocks,f) != ret->nsblocks) {
+    delete ret;
+    return NULL;
+  }
+  ret->ones = ret->Rs[ret->nsblocks-1];
+  for(I k=(ret->nsblocks-1)<<ret->fbits;k<ret->nwords;k++)
+    ret->ones+=popcount64(ret->data[k]);
+  return ret;
+}
+
+template<class I>
+I basic_static_bitsequence_brw64<I>::SpaceRequirementInBits() {
+  return nwords*sizeof(unsigned long long)*8+nsblocks*sizeof(I)*8;
+}
+
+template<class I>
+I basic_static_bitsequence_brw64<I>::size() {
+  return sizeof(basic_static_bitsequence_brw64)+SpaceRequirementInBits()/8;
+}
+
+template class basic_static_bitsequence_brw64<uint>;
+template class basic_static_bitsequence_brw64<unsigned long long>;
@@ -0,0 +1,90 @@
+/* static_bitsequence_brw64.h
+   Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+
+   RANK and SELECT over 64-bit words using hardware popcount.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef _STATIC_BITSEQUENCE_BRW64_H
+#define _STATIC_BITSEQUENCE_BRW64_H
+
+#include <basics.h>
+#include <static_bitsequence.h>
+/////////////
+//Rank(B,i)//
+/////////////
+//superblock of factor 64-bit words, factor is rounded up to a power of two
+//factor=4 => overhead 12.5%
+//factor=8 => overhead 6.25%
+//factor=16=> overhead 3.1%
+
+#define FACTOR64 8
+
+/** 64-bit word sibling of static_bitsequence_brw32 [1]. The bitmap is stored in
+ *  64-bit words and the rank directory keeps one absolute counter every factor
+ *  words. Word level counting and in-word select are done with compiler
+ *  intrinsics (POPCNT, TZCNT and PDEP when available) instead of byte tables.
+ *
+ *  I is the type of the positions and of the counters: uint for the usual
+ *  static_bitsequence_brw64, unsigned long long for the bitmaps of more than
+ *  2^32 bits (static_bitsequence_brw64_large, a static_bitsequence64). Both
+ *  are instantiated in static_bitsequence_brw64.cpp.
+ *
+ *  [1] Rodrigo Gonzalez, Szymon Grabowski, Veli Makinen, and Gonzalo Navarro.
+ *      Practical Implementation of Rank and Select Queries. WEA05.
+ *
+ *  @author Carlos Bedregal
+ */
+template<class I>
+class basic_static_bitsequence_brw64 : public static_bitsequence_of<I>::type {
+private:
+  unsigned long long *data;
+  I *Rs; //superblock array
+  uint factor; //words per superblock
+  uint fbits; //log2(factor)
+  I nwords; //words in data
+  I nsblocks; //entries in Rs
+
+  void BuildRank(); //crea indice para rank
+  basic_static_bitsequence_brw64();
+
+public:
+  basic_static_bitsequence_brw64(uint *bitarray, I n, uint factor=FACTOR64);
+  ~basic_static_bitsequence_brw64(); //destructor
+  virtual bool access(I i);
+  virtual I select1_next(I p, I r, I x);
+  virtual I select0_next(I p, I r, I x);
+  virtual void get_bitmap(uint *bitmap);
+  virtual I rank0(I i);
+  virtual I rank1(I i);
+
+  I prev(I start); // gives the largest index i<=start such that IsBitSet(i)=true
+  I next(I start); // gives the smallest index i>=start such that IsBitSet(i)=true
+  virtual I select0(I x); // gives the position of the x:th 0.
+  virtual I select1(I x); // gives the position of the x:th 1.
+  I SpaceRequirementInBits();
+  virtual I size();
+
+  /*load-save functions*/
+  virtual int save(FILE *f);
+  static basic_static_bitsequence_brw64 * load(FILE * fp);
+};
+
+typedef basic_static_bitsequence_brw64<uint> static_bitsequence_brw64;
+typedef basic_static_bitsequence_brw64<unsigned long long> static_bitsequence_brw64_large;
+
+#endif
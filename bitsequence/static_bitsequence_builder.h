@@ -32,5 +32,9 @@ class static_bitsequence_builder {
 #include <static_bitsequence_builder_rrr02.h>
 #include <static_bitsequence_builder_rrr02_light.h>
 #include <static_bitsequence_builder_brw32.h>
+#include <static_bitsequence_builder_brw64.h>
+#include <static_bitsequence_builder_interleaved.h>
+#include <static_bitsequence_builder_eliasfano.h>
+#include <static_bitsequence_builder_rrr63.h>
 
 #endif /* _STATIC_BITSEQUENCE_BUILDER_H */
@@ -0,0 +1,228 @@
+/* static_bitsequence_eliasfano.cpp
+   Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+
+   RANK and SELECT over sparse bitmaps using the Elias-Fano encoding.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "static_bitsequence_eliasfano.h"
+#include "bitcount.h"
+#include <cassert>
+
+static_bitsequence_eliasfano::static_bitsequence_eliasfano(){
+  len=0;
+  ones=0;
+  lbits=0;
+  low=NULL;
+  high=NULL;
+  nhigh=nhwords=0;
+  sample=EF_SAMPLING;
+  S1=S0=NULL;
+  ns1=ns0=0;
+}
+
+static_bitsequence_eliasfano::static_bitsequence_eliasfano(uint *bitarray, uint n, uint _sample){
+  S1=S0=NULL;
+  sample = _sample ? _sample : EF_SAMPLING;
+  uint m = n ? popcount_bits(bitarray,0,n-1) : 0;
+  init(n,m);
+  uint k=0, lmask=(1u<<lbits)-1;
+  uint n32=uint_len(n,1);
+  for(uint w=0;w<n32;w++){
+    uint word=bitarray[w];
+    if((w+1)*W>n) word &= (1u<<(n%W))-1; //bits beyond n
+    while(word){
+      uint pos=w*W+__builtin_ctz(word);
+      set_field(low,lbits,k,pos&lmask);
+      uint h=(pos>>lbits)+k;
+      high[h/W64] |= 1ULL<<(h%W64);
+      word&=word-1;
+      k++;
+    }
+  }
+  assert(k==m);
+  BuildSampling();
+}
+
+static_bitsequence_eliasfano::~static_bitsequence_eliasfano() {
+  delete [] low;
+  delete [] high;
+  delete [] S1;
+  delete [] S0;
+}
+
+void static_bitsequence_eliasfano::init(uint n, uint m){
+  len=n;
+  ones=m;
+  lbits = (m!=0 && n/m>1) ? bits(n/m)-1 : 0;
+  uint nlow=uint_len(m,lbits)+1;
+  low=new uint[nlow];
+  for(uint i=0;i<nlow;i++) low[i]=0;
+  nhigh=m+(n>>lbits)+1;
+  nhwords=nhigh/W64+1;
+  high=new unsigned long long[nhwords];
+  for(uint i=0;i<nhwords;i++) high[i]=0;
+}
+
+void static_bitsequence_eliasfano::BuildSampling(){
+  delete [] S1;
+  delete [] S0;
+  //S1[s] = position of the (s*sample+1)-th one, S0[s] the same for zeros
+  ns1=(ones+sample-1)/sample;
+  ns0=(nhigh-ones+sample-1)/sample;
+  S1=new uint[ns1+1];
+  S0=new uint[ns0+1];
+  uint c1=0, c0=0, s1=0, s0=0;
+  for(uint w=0;w<nhwords;w++){
+    unsigned long long word=high[w];
+    uint o=popcount64(word), z=W64-o;
+    while(s1<ns1 && s1*sample+1<=c1+o){
+      S1[s1]=w*W64+select64(word,s1*sample+1-c1);
+      s1++;
+    }
+    while(s0<ns0 && s0*sample+1<=c0+z){
+      S0[s0]=w*W64+select64(~word,s0*sample+1-c0);
+      s0++;
+    }
+    c1+=o;
+    c0+=z;
+  }
+  S1[ns1]=S0[ns0]=nhigh;
+}
+
+inline uint static_bitsequence_eliasfano::high_select1(uint x){
+  uint s=(x-1)/sample;
+  uint p=S1[s];
+  x-=s*sample; //the sample is the first one counted
+  uint w=p/W64;
+  unsigned long long word=high[w] & (~0ULL<<(p%W64));
+  uint cnt=popcount64(word);
+  while(cnt<x){
+    x-=cnt;
+    word=high[++w];
+    cnt=popcount64(word);
+  }
+  return w*W64+select64(word,x);
+}
+
+inline uint static_bitsequence_eliasfano::high_select0(uint x){
+  uint s=(x-1)/sample;
+  uint p=S0[s];
+  x-=s*sample;
+  uint w=p/W64;
+  unsigned long long word=~high[w] & (~0ULL<<(p%W64));
+  uint cnt=popcount64(word);
+  while(cnt<x){
+    x-=cnt;
+    word=~high[++w];
+    cnt=popcount64(word);
+  }
+  return w*W64+select64(word,x);
+}
+
+uint static_bitsequence_eliasfano::rank1(uint i) {
+  if(i>=len) return ones;
+  uint b=i>>lbits, li=i&((1u<<lbits)-1);
+  //bucket b starts after the b-th zero of high, with p-b ones before it
+  uint p = b ? high_select0(b)+1 : 0;
+  uint k=p-b;
+  while((high[p/W64]>>(p%W64)) & 1){
+    if(get_field(low,lbits,k)>li) break;
+    k++;
+    p++;
+  }
+  return k;
+}
+
+bool static_bitsequence_eliasfano::access(uint i) {
+  if(i>=len) return false;
+  uint b=i>>lbits, li=i&((1u<<lbits)-1);
+  uint p = b ? high_select0(b)+1 : 0;
+  uint k=p-b;
+  while((high[p/W64]>>(p%W64)) & 1){
+    uint v=get_field(low,lbits,k);
+    if(v>=li) return v==li;
+    k++;
+    p++;
+  }
+  return false;
+}
+
+void static_bitsequence_eliasfano::get_bitmap(uint *bitmap) {
+  for(uint k=0;k<uint_len(len,1);k++) bitmap[k]=0;
+  //the k-th one of high at position p is the one at ((p-k)<<lbits)|low[k]
+  uint k=0;
+  for(uint w=0;w<nhwords;w++){
+    unsigned long long word=high[w];
+    while(word){
+      uint p=w*W64+__builtin_ctzll(word);
+      bitset(bitmap,((p-k)<<lbits) | get_field(low,lbits,k));
+      word&=word-1;
+      k++;
+    }
+  }
+}
+
+uint static_bitsequence_eliasfano::select1(uint x) {
+  // returns i such that x=rank(i) && rank(i-1)<x or n if that i not exist
+  if(x==0) return (uint)-1;
+  if(x>ones) return len;
+  uint p=high_select1(x);
+  return ((p-(x-1))<<lbits) | get_field(low,lbits,x-1);
+}
+
+uint static_bitsequence_eliasfano::SpaceRequirementInBits() {
+  return (uint_len(ones,lbits)+1)*W+nhwords*W64+(ns1+1+ns0+1)*W;
+}
+
+uint static_bitsequence_eliasfano::size() {
+  return sizeof(static_bitsequence_eliasfano)+SpaceRequirementInBits()/8;
+}
+
+int static_bitsequence_eliasfano::save(FILE *f) {
+  uint wr = ELIASFANO_HDR;
+  if (f == NULL) return 20;
+  if (fwrite (&wr,sizeof(uint),1,f) != 1) return 21;
+  if (fwrite (&len,sizeof(uint),1,f) != 1) return 21;
+  if (fwrite (&ones,sizeof(uint),1,f) != 1) return 21;
+  if (fwrite (&sample,sizeof(uint),1,f) != 1) return 21;
+  uint nlow=uint_len(ones,lbits)+1;
+  if (fwrite (low,sizeof(uint),nlow,f) != nlow) return 21;
+  if (fwrite (high,sizeof(unsigned long long),nhwords,f) != nhwords) return 21;
+  return 0;
+}
+
+static_bitsequence_eliasfano * static_bitsequence_eliasfano::load(FILE *f) {
+  if (f == NULL) return NULL;
+  uint type, n, m, sample;
+  if (fread (&type,sizeof(uint),1,f) != 1 || type != ELIASFANO_HDR) return NULL;
+  if (fread (&n,sizeof(uint),1,f) != 1 ||
+      fread (&m,sizeof(uint),1,f) != 1 ||
+      fread (&sample,sizeof(uint),1,f) != 1 || sample==0 || m>n)
+    return NULL;
+  static_bitsequence_eliasfano * ret = new static_bitsequence_eliasfano();
+  ret->sample=sample;
+  ret->init(n,m);
+  uint nlow=uint_len(m,ret->lbits)+1;
+  if (fread (ret->low,sizeof(uint),nlow,f) != nlow ||
+      fread (ret->high,sizeof(unsigned long long),ret->nhwords,f) != ret->nhwords) {
+    delete ret;
+    return NULL;
+  }
+  ret->BuildSampling();
+  return ret;
+}
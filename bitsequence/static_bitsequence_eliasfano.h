@@ -0,0 +1,87 @@
+/* static_bitsequence_eliasfano.h
+   Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+
+   RANK and SELECT over sparse bitmaps using the Elias-Fano encoding.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef _STATIC_BITSEQUENCE_ELIASFANO_H
+#define _STATIC_BITSEQUENCE_ELIASFANO_H
+
+#include <basics.h>
+#include <static_bitsequence.h>
+
+//////////////////
+//Representation//
+//////////////////
+//the k-th one at position x is split into low=x%2^l and high=x>>l, with
+//l=floor(log(n/m)) for m ones. Lows are packed in m*l bits, and the k-th
+//one sets bit high+k of the high bitmap (m+n/2^l+1 bits, unary buckets)
+//space: m*(2+l) bits + samples
+
+//a sample every EF_SAMPLING ones (zeros) of the high bitmap
+#define EF_SAMPLING 256
+
+/** Elias-Fano [1,2] representation of a sparse bitmap of n bits and m ones,
+ *  using about m*(2+log(n/m)) bits. select1 is solved in constant time by
+ *  sampling the positions of the ones in the high bitmap; rank1 jumps to the
+ *  bucket of the position with the zero samples and scans the few ones
+ *  sharing its high part.
+ *
+ *  [1] P. Elias. Efficient Storage and Retrieval by Content and Address of
+ *      Static Files. JACM 1974.
+ *  [2] D. Okanohara and K. Sadakane. Practical Entropy-Compressed Rank/Select
+ *      Dictionary. ALENEX07.
+ *
+ *  @author Carlos Bedregal
+ */
+class static_bitsequence_eliasfano : public static_bitsequence {
+private:
+  uint lbits; //bits of each low part
+  uint *low; //low parts, lbits each
+  unsigned long long *high; //high parts in unary
+  uint nhigh; //bits in high
+  uint nhwords; //words in high
+  uint sample; //ones (zeros) between samples
+  uint *S1, *S0; //position in high of every sample-th one (zero)
+  uint ns1, ns0; //number of samples
+
+  static_bitsequence_eliasfano();
+  void init(uint n, uint m);
+  void BuildSampling(); //fills S1 and S0 from high
+
+  /** position in high of the x-th one (x>=1) */
+  inline uint high_select1(uint x);
+  /** position in high of the x-th zero (x>=1) */
+  inline uint high_select0(uint x);
+
+public:
+  static_bitsequence_eliasfano(uint *bitarray, uint n, uint sample=EF_SAMPLING);
+  ~static_bitsequence_eliasfano(); //destructor
+  virtual bool access(uint i);
+  virtual void get_bitmap(uint *bitmap);
+  virtual uint rank1(uint i);
+  virtual uint select1(uint x); // gives the position of the x:th 1.
+  uint SpaceRequirementInBits();
+  virtual uint size();
+
+  /*load-save functions*/
+  virtual int save(FILE *f);
+  static static_bitsequence_eliasfano * load(FILE * fp);
+};
+
+#endif
@@ -0,0 +1,238 @@
+/* static_bitsequence_interleaved.cpp
+   Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+
+   RANK and SELECT with the rank directory interleaved with the bitmap.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "static_bitsequence_interleaved.h"
+#include <cassert>
+
+/** allocates nwords 64-bit words aligned to a cache line */
+static unsigned long long * alloc_lines(uint nwords){
+  void *p=NULL;
+  if(posix_memalign(&p,IL_LINE_WORDS*sizeof(unsigned long long),(size_t)nwords*sizeof(unsigned long long))!=0)
+    return NULL;
+  return (unsigned long long *)p;
+}
+
+static_bitsequence_interleaved::static_bitsequence_interleaved(){
+  lines=NULL;
+  nlines=0;
+  len=0;
+  ones=0;
+  sel_sample=0;
+  Ss1=Ss0=NULL;
+  nsel1=nsel0=0;
+}
+
+static_bitsequence_interleaved::static_bitsequence_interleaved(uint *bitarray, uint _n, uint _sel_sample){
+  len=_n;
+  nlines=len/IL_LINE_BITS+1;
+  lines=alloc_lines(nlines*IL_LINE_WORDS);
+  uint n32=uint_len(len,1);
+  for(uint l=0;l<nlines;l++){
+    unsigned long long *line=lines+l*IL_LINE_WORDS;
+    line[0]=0;
+    for(uint w=0;w<IL_DATA_WORDS;w++){
+      uint k=2*(l*IL_DATA_WORDS+w); //first 32-bit word of bitarray
+      unsigned long long lo = (k<n32) ? bitarray[k] : 0;
+      unsigned long long hi = (k+1<n32) ? bitarray[k+1] : 0;
+      line[1+w] = lo | (hi<<W);
+    }
+  }
+  //clean the bits beyond len
+  uint last=len/IL_LINE_BITS, off=len%IL_LINE_BITS;
+  lines[last*IL_LINE_WORDS+1+off/W64] &= (1ULL<<(off%W64))-1;
+  for(uint w=off/W64+1;w<IL_DATA_WORDS;w++)
+    lines[last*IL_LINE_WORDS+1+w]=0;
+  BuildRank();
+  Ss1=Ss0=NULL;
+  sel_sample=0;
+  create_select_sampling(_sel_sample);
+}
+
+static_bitsequence_interleaved::~static_bitsequence_interleaved() {
+  free(lines);
+  delete [] Ss1;
+  delete [] Ss0;
+}
+
+void static_bitsequence_interleaved::BuildRank(){
+  uint acc=0;
+  for(uint l=0;l<nlines;l++){
+    unsigned long long *line=lines+l*IL_LINE_WORDS;
+    unsigned long long c0=popcount64(line[1]);
+    unsigned long long c1=c0+popcount64(line[2]);
+    unsigned long long c2=c1+popcount64(line[3]);
+    line[0] = (unsigned long long)acc | (c0<<32) | (c1<<40) | (c2<<48);
+    for(uint w=0;w<IL_DATA_WORDS;w++)
+      acc+=popcount64(line[1+w]);
+  }
+  ones=acc;
+}
+
+void static_bitsequence_interleaved::create_select_sampling(uint _sel_sample){
+  delete [] Ss1;
+  delete [] Ss0;
+  Ss1=Ss0=NULL;
+  nsel1=nsel0=0;
+  sel_sample=_sel_sample;
+  if(sel_sample==0) return;
+  //Ss1[k] = last line l with line_rank(l) < k*sel_sample+1
+  nsel1=(ones+sel_sample-1)/sel_sample;
+  Ss1=new uint[nsel1+1];
+  uint l=0;
+  for(uint k=0;k<nsel1;k++){
+    uint x=k*sel_sample+1;
+    while(l+1<nlines && line_rank(l+1)<x) l++;
+    Ss1[k]=l;
+  }
+  Ss1[nsel1]=nlines-1;
+  //Ss0[k] = last line l with line_rank0(l) < k*sel_sample+1
+  nsel0=(len-ones+sel_sample-1)/sel_sample;
+  Ss0=new uint[nsel0+1];
+  l=0;
+  for(uint k=0;k<nsel0;k++){
+    uint x=k*sel_sample+1;
+    while(l+1<nlines && line_rank0(l+1)<x) l++;
+    Ss0[k]=l;
+  }
+  Ss0[nsel0]=nlines-1;
+}
+
+inline uint static_bitsequence_interleaved::inline_rank(const unsigned long long *line, uint w){
+  if(w==0) return 0;
+  if(w<=3) return (line[0]>>(24+8*w)) & 0xff;
+  uint resp=(line[0]>>48) & 0xff;
+  for(uint k=3;k<w;k++)
+    resp+=popcount64(line[1+k]);
+  return resp;
+}
+
+uint static_bitsequence_interleaved::rank1(uint i) {
+  if(i>=len) return ones;
+  ++i;
+  const unsigned long long *line=lines+(i/IL_LINE_BITS)*IL_LINE_WORDS;
+  uint off=i%IL_LINE_BITS;
+  uint w=off/W64;
+  return (uint)line[0] + inline_rank(line,w)
+         + popcount64(line[1+w] & ((1ULL<<(off%W64))-1));
+}
+
+uint static_bitsequence_interleaved::rank0(uint i) {
+  if(i>=len) return len-ones;
+  return i+1-rank1(i);
+}
+
+bool static_bitsequence_interleaved::access(uint i) {
+  uint off=i%IL_LINE_BITS;
+  return (lines[(i/IL_LINE_BITS)*IL_LINE_WORDS+1+off/W64] >> (off%W64)) & 1;
+}
+
+uint static_bitsequence_interleaved::select1(uint x) {
+  if(x==0) return (uint)-1;
+  if(x>ones) return len;
+  uint l=0, r=nlines-1;
+  if(sel_sample){
+    uint k=(x-1)/sel_sample;
+    l=Ss1[k]; r=Ss1[k+1];
+  }
+  //last line with line_rank < x
+  while(l<r){
+    uint mid=(l+r+1)/2;
+    if(line_rank(mid)<x) l=mid;
+    else r=mid-1;
+  }
+  const unsigned long long *line=lines+l*IL_LINE_WORDS;
+  x-=(uint)line[0];
+  uint w=0;
+  while(w<3 && inline_rank(line,w+1)<x) w++;
+  x-=inline_rank(line,w);
+  uint cnt=popcount64(line[1+w]);
+  while(cnt<x){
+    x-=cnt;
+    cnt=popcount64(line[1+(++w)]);
+  }
+  return l*IL_LINE_BITS+w*W64+select64(line[1+w],x);
+}
+
+uint static_bitsequence_interleaved::select0(uint x) {
+  if(x==0) return (uint)-1;
+  if(x>len-ones) return len;
+  uint l=0, r=nlines-1;
+  if(sel_sample){
+    uint k=(x-1)/sel_sample;
+    l=Ss0[k]; r=Ss0[k+1];
+  }
+  //last line with line_rank0 < x
+  while(l<r){
+    uint mid=(l+r+1)/2;
+    if(line_rank0(mid)<x) l=mid;
+    else r=mid-1;
+  }
+  const unsigned long long *line=lines+l*IL_LINE_WORDS;
+  x-=line_rank0(l);
+  uint w=0;
+  while(w<3 && (w+1)*W64-inline_rank(line,w+1)<x) w++;
+  x-=w*W64-inline_rank(line,w);
+  uint cnt=W64-popcount64(line[1+w]);
+  while(cnt<x){
+    x-=cnt;
+    cnt=W64-popcount64(line[1+(++w)]);
+  }
+  return l*IL_LINE_BITS+w*W64+select64(~line[1+w],x);
+}
+
+uint static_bitsequence_interleaved::size() {
+  uint sampling = sel_sample ? (nsel1+1+nsel0+1)*sizeof(uint) : 0;
+  return sizeof(static_bitsequence_interleaved)+nlines*IL_LINE_WORDS*sizeof(unsigned long long)+sampling;
+}
+
+int static_bitsequence_interleaved::save(FILE *f) {
+  uint wr = INTERLEAVED_HDR;
+  if (f == NULL) return 20;
+  if (fwrite (&wr,sizeof(uint),1,f) != 1) return 21;
+  if (fwrite (&len,sizeof(uint),1,f) != 1) return 21;
+  if (fwrite (&sel_sample,sizeof(uint),1,f) != 1) return 21;
+  if (fwrite (lines,sizeof(unsigned long long),nlines*IL_LINE_WORDS,f) != nlines*IL_LINE_WORDS) return 21;
+  return 0;
+}
+
+static_bitsequence_interleaved * static_bitsequence_interleaved::load(FILE *f) {
+  if (f == NULL) return NULL;
+  uint type, sample;
+  if (fread (&type,sizeof(uint),1,f) != 1 || type != INTERLEAVED_HDR) return NULL;
+  static_bitsequence_interleaved * ret = new static_bitsequence_interleaved();
+  if (fread (&ret->len,sizeof(uint),1,f) != 1 ||
+      fread (&sample,sizeof(uint),1,f) != 1) {
+    delete ret;
+    return NULL;
+  }
+  ret->nlines = ret->len/IL_LINE_BITS+1;
+  ret->lines = alloc_lines(ret->nlines*IL_LINE_WORDS);
+  if (!ret->lines || fread (ret->lines,sizeof(unsigned long long),ret->nlines*IL_LINE_WORDS,f) != ret->nlines*IL_LINE_WORDS) {
+    delete ret;
+    return NULL;
+  }
+  const unsigned long long *last=ret->lines+(ret->nlines-1)*IL_LINE_WORDS;
+  ret->ones = (uint)last[0];
+  for(uint w=0;w<IL_DATA_WORDS;w++)
+    ret->ones += popcount64(last[1+w]);
+  ret->create_select_sampling(sample);
+  return ret;
+}
@@ -0,0 +1,89 @@
+/* static_bitsequence_interleaved.h
+   Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+
+   RANK and SELECT with the rank directory interleaved with the bitmap.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef _STATIC_BITSEQUENCE_INTERLEAVED_H
+#define _STATIC_BITSEQUENCE_INTERLEAVED_H
+
+#include <basics.h>
+#include <static_bitsequence.h>
+
+/////////////////////
+//Cache line layout//
+/////////////////////
+//| counter | data0 | data1 | ... | data6 |   8 words of 64 bits = 64 bytes
+//counter: bits 0..31  number of ones before the line
+//         bits 32..55 ones in data0, data0..1 and data0..2 (8 bits each)
+//overhead: 64/448 = 14.3%
+
+#define IL_LINE_WORDS 8
+#define IL_DATA_WORDS 7
+#define IL_LINE_BITS 448 //IL_DATA_WORDS*W64
+
+//a select sample every IL_SELECT_SAMPLING ones (zeros), 0=no sampling
+#define IL_SELECT_SAMPLING 1024
+
+/** Rank/select bitsequence in the spirit of Vigna's rank9 [1], where each
+ *  64-byte cache line holds the absolute rank counter followed by the seven
+ *  64-bit words of bitmap it covers, so rank1 touches a single cache line.
+ *  Select binary searches the counters between two samples taken every
+ *  sel_sample ones (zeros) and finishes inside one line.
+ *
+ *  [1] S. Vigna. Broadword Implementation of Rank/Select Queries. WEA08.
+ *
+ *  @author Carlos Bedregal
+ */
+class static_bitsequence_interleaved : public static_bitsequence {
+private:
+  unsigned long long *lines; //cache line aligned counters+bitmap
+  uint nlines; //number of lines
+  uint sel_sample; //ones (zeros) between select samples, 0=no sampling
+  uint *Ss1, *Ss0; //line of every sel_sample-th one (zero)
+  uint nsel1, nsel0; //number of samples in Ss1 and Ss0 (without sentinel)
+
+  void BuildRank(); //fills the counters of each line
+  static_bitsequence_interleaved();
+
+  /** ones before the line */
+  inline uint line_rank(uint l) { return (uint)lines[l*IL_LINE_WORDS]; }
+  /** zeros before the line */
+  inline uint line_rank0(uint l) { return l*IL_LINE_BITS-line_rank(l); }
+  /** ones of the line before data word w (w<=IL_DATA_WORDS) */
+  inline uint inline_rank(const unsigned long long *line, uint w);
+
+public:
+  static_bitsequence_interleaved(uint *bitarray, uint n, uint sel_sample=IL_SELECT_SAMPLING);
+  ~static_bitsequence_interleaved(); //destructor
+  virtual bool access(uint i);
+  virtual uint rank0(uint i);
+  virtual uint rank1(uint i);
+  virtual uint select0(uint x); // gives the position of the x:th 0.
+  virtual uint select1(uint x); // gives the position of the x:th 1.
+  virtual uint size();
+
+  /** Creates (or replaces) the select sampling, 0 removes it */
+  void create_select_sampling(uint sel_sample);
+
+  /*load-save functions*/
+  virtual int save(FILE *f);
+  static static_bitsequence_interleaved * load(FILE * fp);
+};
+
+#endif
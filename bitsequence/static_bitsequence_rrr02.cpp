@@ -19,15 +19,21 @@
  *
  */
 
+#include <mutex>
 #include <static_bitsequence_rrr02.h>
 
 table_offset * static_bitsequence_rrr02::E = NULL;
+//E is shared by all the instances, which may be built by several threads
+static std::mutex E_mutex;
 
 static_bitsequence_rrr02::static_bitsequence_rrr02() {
 	ones=0;
 	len=0;
-	if(E==NULL) E = new table_offset(BLOCK_SIZE);
-  E->use();
+  {
+    std::lock_guard<std::mutex> lock(E_mutex);
+    if(E==NULL) E = new table_offset(BLOCK_SIZE);
+    E->use();
+  }
 	C = NULL;
 	O = NULL;
 	C_sampling = NULL;
@@ -40,8 +46,11 @@ static_bitsequence_rrr02::static_bitsequence_rrr02() {
 static_bitsequence_rrr02::static_bitsequence_rrr02(uint * bitseq, uint len, uint sample_rate) {
 	ones = 0;
 	this->len = len;
-	if(E==NULL) E = new table_offset(BLOCK_SIZE);
-  E->use();
+  {
+    std::lock_guard<std::mutex> lock(E_mutex);
+    if(E==NULL) E = new table_offset(BLOCK_SIZE);
+    E->use();
+  }
 	// Table C
 	C_len = len/BLOCK_SIZE + (len%BLOCK_SIZE!=0);
 	C_field_bits = bits(BLOCK_SIZE);
@@ -64,8 +73,9 @@ static_bitsequence_rrr02::static_bitsequence_rrr02(uint * bitseq, uint len, uint
 	uint O_pos = 0;
 	for(uint i=0;i<C_len;i++) {
 		uint value = (ushort)get_var_field(bitseq,i*BLOCK_SIZE,min((uint)len-1,(i+1)*BLOCK_SIZE-1));
-		set_var_field(O,O_pos,O_pos+E->get_log2binomial(BLOCK_SIZE,popcount(value))-1,E->compute_offset((ushort)value));
-		O_pos += E->get_log2binomial(BLOCK_SIZE,popcount(value));
+		uint bits_c = E->get_log2binomial(BLOCK_SIZE,get_field(C,C_field_bits,i)); //class from table C
+		set_var_field(O,O_pos,O_pos+bits_c-1,E->compute_offset((ushort)value));
+		O_pos += bits_c;
 	}
 	C_sampling = NULL;
   this->O_pos = NULL;
@@ -271,6 +281,126 @@ uint static_bitsequence_rrr02::select1(uint i) {
 	return pos;
 }
 
+void static_bitsequence_rrr02::get_bitmap(uint *bitmap) {
+	uint pos_O = 0;
+	if(len) bitmap[uint_len(len,1)-1] = 0;
+	for(uint k=0;k*BLOCK_SIZE<len;k++) {
+		uint c = get_field(C,C_field_bits,k);
+		uint nb = E->get_log2binomial(BLOCK_SIZE,c);
+		uint block = E->short_bitmap(c,get_var_field(O,pos_O,pos_O+nb-1));
+		uint last = min(len,(k+1)*BLOCK_SIZE)-1;
+		set_var_field(bitmap,k*BLOCK_SIZE,last,block & ((1<<(last-k*BLOCK_SIZE+1))-1));
+		pos_O += nb;
+	}
+}
+
+uint static_bitsequence_rrr02::select1_from(uint &pos, uint &acc, uint &pos_O, uint x) {
+	uint s;
+	for(;;pos++) {
+		s = get_field(C,C_field_bits,pos);
+		if(acc+s>=x) break;
+		acc += s;
+		pos_O += E->get_log2binomial(BLOCK_SIZE,s);
+	}
+	uint block = E->short_bitmap(s,get_var_field(O,pos_O,pos_O+E->get_log2binomial(BLOCK_SIZE,s)-1));
+	return pos*BLOCK_SIZE+select64(block,x-acc);
+}
+
+uint static_bitsequence_rrr02::select1_sample(uint l, uint r, uint x) {
+	while(l<r) {
+		uint mid = (l+r+1)/2;
+		if(get_field(C_sampling,C_sampling_field_bits,mid)<x) l = mid;
+		else r = mid-1;
+	}
+	return l;
+}
+
+void static_bitsequence_rrr02::rank1_batch(const uint *I, uint n, uint *out) {
+	if(is_sorted(I,n)) {
+		//the sum of the previous query is extended while the next one falls
+		//under the same sample
+		uint cur = (uint)-1, k = 0, sum = 0, pos_O = 0;
+		for(uint q=0;q<n;q++) {
+			uint i = I[q];
+			if(i+1==0) { out[q] = 0; continue; }
+			uint pos = i/BLOCK_SIZE;
+			if(pos/sample_rate!=cur) {
+				cur = pos/sample_rate;
+				sum = get_field(C_sampling,C_sampling_field_bits,cur);
+				pos_O = get_field(O_pos,O_pos_field_bits,cur);
+				k = cur*sample_rate;
+			}
+			for(;k<pos;k++) {
+				uint aux = get_field(C,C_field_bits,k);
+				sum += aux;
+				pos_O += E->get_log2binomial(BLOCK_SIZE,aux);
+			}
+			uint c = get_field(C,C_field_bits,pos);
+			out[q] = sum+popcount(((2<<(i%BLOCK_SIZE))-1) & E->short_bitmap(c,get_var_field(O,pos_O,pos_O+E->get_log2binomial(BLOCK_SIZE,c)-1)));
+		}
+		return;
+	}
+	for(uint q=0;q<n;q++) {
+		if(q+BATCH_PREFETCH<n) {
+			uint pos = I[q+BATCH_PREFETCH]/BLOCK_SIZE, s = pos/sample_rate;
+			__builtin_prefetch(C_sampling+s*C_sampling_field_bits/W);
+			__builtin_prefetch(O_pos+s*O_pos_field_bits/W);
+			__builtin_prefetch(C+s*sample_rate*C_field_bits/W);
+		}
+		out[q] = static_bitsequence_rrr02::rank1(I[q]);
+	}
+}
+
+void static_bitsequence_rrr02::select1_batch(const uint *X, uint n, uint *out) {
+	uint last = C_len ? (C_len-1)/sample_rate : 0; //last sample with blocks
+	if(is_sorted(X,n)) {
+		//the scan continues from the block of the previous answer unless the
+		//next sample already has less than x ones before it
+		uint cur = (uint)-1, pos = 0, acc = 0, pos_O = 0;
+		for(uint q=0;q<n;q++) {
+			uint x = X[q];
+			if(x==0 || x>ones) { out[q] = static_bitsequence_rrr02::select1(x); continue; }
+			if(cur==(uint)-1 || get_field(C_sampling,C_sampling_field_bits,cur+1)<x) {
+				cur = select1_sample(cur==(uint)-1 ? 0 : cur+1,last,x);
+				pos = cur*sample_rate;
+				acc = get_field(C_sampling,C_sampling_field_bits,cur);
+				pos_O = get_field(O_pos,O_pos_field_bits,cur);
+			}
+			out[q] = select1_from(pos,acc,pos_O,x);
+		}
+		return;
+	}
+	//lockstep binary searches over C_sampling, each step prefetches the next probe
+	uint lo[BATCH_GROUP], hi[BATCH_GROUP];
+	for(uint base=0;base<n;base+=BATCH_GROUP) {
+		uint m = min((uint)BATCH_GROUP,n-base);
+		for(uint j=0;j<m;j++) {
+			lo[j] = 0;
+			hi[j] = (X[base+j]==0 || X[base+j]>ones) ? 0 : last;
+		}
+		bool active = true;
+		while(active) {
+			active = false;
+			for(uint j=0;j<m;j++) {
+				if(lo[j]>=hi[j]) continue;
+				uint mid = (lo[j]+hi[j]+1)/2;
+				if(get_field(C_sampling,C_sampling_field_bits,mid)<X[base+j]) lo[j] = mid;
+				else hi[j] = mid-1;
+				__builtin_prefetch(C_sampling+(lo[j]+hi[j]+1)/2*C_sampling_field_bits/W);
+				active = true;
+			}
+		}
+		for(uint j=0;j<m;j++) {
+			uint x = X[base+j];
+			if(x==0 || x>ones) { out[base+j] = static_bitsequence_rrr02::select1(x); continue; }
+			uint pos = lo[j]*sample_rate;
+			uint acc = get_field(C_sampling,C_sampling_field_bits,lo[j]);
+			uint pos_O = get_field(O_pos,O_pos_field_bits,lo[j]);
+			out[base+j] = select1_from(pos,acc,pos_O,x);
+		}
+	}
+}
+
 uint static_bitsequence_rrr02::size() {
   /*cout << "RRR02 SIZE: " << endl;
   cout << "Default: " << 9*sizeof(uint)+sizeof(uint*)*4 << endl;
@@ -293,7 +423,10 @@ static_bitsequence_rrr02::~static_bitsequence_rrr02() {
 	if(O!=NULL) delete [] O;
 	if(C_sampling!=NULL) delete [] C_sampling;
 	if(O_pos!=NULL) delete [] O_pos;
-  E = E->unuse();
+  {
+    std::lock_guard<std::mutex> lock(E_mutex);
+    E = E->unuse();
+  }
 }
 
 int static_bitsequence_rrr02::save(FILE * fp) {
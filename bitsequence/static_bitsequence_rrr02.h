@@ -65,6 +65,15 @@ public:
   /** Returns the i-th bit */
   virtual bool access(uint i);
 
+  /** Batched queries: sorted inputs continue scanning the classes from the
+   *  block of the previous query; otherwise independent lookups are
+   *  prefetched ahead (rank) or binary searched in lockstep (select) */
+  virtual void rank1_batch(const uint *I, uint n, uint *out);
+  virtual void select1_batch(const uint *X, uint n, uint *out);
+
+  /** Decodes the blocks in order */
+  virtual void get_bitmap(uint *bitmap);
+
   /** Returns the size of the structure in bytes */
   virtual uint size();
 
@@ -87,6 +96,12 @@ public:
 
 protected:
   static_bitsequence_rrr02();
+	/** Position of the x-th one scanning the classes from block pos, with acc
+	 *  ones and offset pos_O before it. Leaves pos, acc and pos_O at the block
+	 *  holding the answer */
+	uint select1_from(uint &pos, uint &acc, uint &pos_O, uint x);
+	/** Last sample in [l,r] with less than x ones before it */
+	uint select1_sample(uint l, uint r, uint x);
 	/** Classes and offsets */
   uint *C, *O;
 	/** Length of C and O (in uints) */
@@ -19,6 +19,7 @@
  *
  */
 
+#include <mutex>
 #include <static_bitsequence_rrr02_light.h>
 
 #define VARS_NEEDED uint C_len = len/BLOCK_SIZE_LIGHT + (len%BLOCK_SIZE_LIGHT!=0);\
@@ -31,12 +32,17 @@ uint O_pos_field_bits = bits(O_bits_len);
 
 
 table_offset * static_bitsequence_rrr02_light::E = NULL;
+//E is shared by all the instances, which may be built by several threads
+static std::mutex E_mutex;
 
 static_bitsequence_rrr02_light::static_bitsequence_rrr02_light() {
   ones=0;
   len=0;
-  if(E==NULL) E = new table_offset(BLOCK_SIZE_LIGHT);
-  E->use();
+  {
+    std::lock_guard<std::mutex> lock(E_mutex);
+    if(E==NULL) E = new table_offset(BLOCK_SIZE_LIGHT);
+    E->use();
+  }
   C = NULL;
   O = NULL;
   C_sampling = NULL;
@@ -48,8 +54,11 @@ static_bitsequence_rrr02_light::static_bitsequence_rrr02_light() {
 static_bitsequence_rrr02_light::static_bitsequence_rrr02_light(uint * bitseq, uint len, uint sample_rate) {
   ones = 0;
   this->len = len;
-  if(E==NULL) E = new table_offset(BLOCK_SIZE_LIGHT);
-  E->use();
+  {
+    std::lock_guard<std::mutex> lock(E_mutex);
+    if(E==NULL) E = new table_offset(BLOCK_SIZE_LIGHT);
+    E->use();
+  }
   // Table C
   uint C_len = len/BLOCK_SIZE_LIGHT + (len%BLOCK_SIZE_LIGHT!=0);
   uint C_field_bits = bits(BLOCK_SIZE_LIGHT);
@@ -72,8 +81,9 @@ static_bitsequence_rrr02_light::static_bitsequence_rrr02_light(uint * bitseq, ui
   uint O_pos = 0;
   for(uint i=0;i<C_len;i++) {
     uint value = (ushort)get_var_field(bitseq,i*BLOCK_SIZE_LIGHT,min((uint)len-1,(i+1)*BLOCK_SIZE_LIGHT-1));
-    set_var_field(O,O_pos,O_pos+E->get_log2binomial(BLOCK_SIZE_LIGHT,popcount(value))-1,E->compute_offset((ushort)value));
-    O_pos += E->get_log2binomial(BLOCK_SIZE_LIGHT,popcount(value));
+    uint bits_c = E->get_log2binomial(BLOCK_SIZE_LIGHT,get_field(C,C_field_bits,i)); //class from table C
+    set_var_field(O,O_pos,O_pos+bits_c-1,E->compute_offset((ushort)value));
+    O_pos += bits_c;
   }
   C_sampling = NULL;
   this->O_pos = NULL;
@@ -320,7 +330,10 @@ static_bitsequence_rrr02_light::~static_bitsequence_rrr02_light() {
   if(O!=NULL) delete [] O;
   if(C_sampling!=NULL) delete [] C_sampling;
   if(O_pos!=NULL) delete [] O_pos;
-  E = E->unuse();
+  {
+    std::lock_guard<std::mutex> lock(E_mutex);
+    E = E->unuse();
+  }
 }
 
 int static_bitsequence_rrr02_light::save(FILE * fp) {
@@ -0,0 +1,345 @@
+/* static_bitsequence_rrr63.cpp
+   Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+
+   RRR compressed bitmap with 63-bit blocks and arithmetic offsets.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "static_bitsequence_rrr63.h"
+#include <cassert>
+
+#define MASK63 0x7FFFFFFFFFFFFFFFULL
+
+/** binomial[p][k] = C(p,k) for p,k<64; C(63,31) < 2^63 */
+static unsigned long long binomial[BLOCK_SIZE63+1][BLOCK_SIZE63+1];
+/** bits of the offsets of class c: ceil(log C(63,c)) */
+static uint obits[BLOCK_SIZE63+1];
+
+static bool fill_tables(){
+  for(uint p=0;p<=BLOCK_SIZE63;p++){
+    binomial[p][0]=1;
+    for(uint k=1;k<=BLOCK_SIZE63;k++)
+      binomial[p][k] = p==0 ? 0 : binomial[p-1][k-1]+binomial[p-1][k];
+  }
+  for(uint c=0;c<=BLOCK_SIZE63;c++)
+    obits[c] = binomial[BLOCK_SIZE63][c]>1 ? msb64(binomial[BLOCK_SIZE63][c]-1)+1 : 0;
+  return true;
+}
+
+/** fills the tables once, before any instance or coder uses them */
+static inline void init_tables(){
+  static bool done = fill_tables();
+  (void)done;
+}
+
+/** reads nb<=64 bits of A starting at bit p */
+static inline unsigned long long get_bits64(const unsigned long long *A, uint p, uint nb){
+  if(nb==0) return 0;
+  uint w=p/W64, o=p%W64;
+  unsigned long long v=A[w]>>o;
+  if(o+nb>W64) v|=A[w+1]<<(W64-o);
+  return nb==W64 ? v : v&((1ULL<<nb)-1);
+}
+
+/** writes the nb bits of x in A (cleaned) starting at bit p */
+static inline void set_bits64(unsigned long long *A, uint p, uint nb, unsigned long long x){
+  if(nb==0) return;
+  uint w=p/W64, o=p%W64;
+  A[w]|=x<<o;
+  if(o+nb>W64) A[w+1]|=x>>(W64-o);
+}
+
+/** k-th block of 63 bits of the bitmap A of n bits */
+static inline unsigned long long read_block(uint *A, uint n, uint k){
+  uint ini=k*BLOCK_SIZE63, fin=min(ini+BLOCK_SIZE63-1,n-1);
+  unsigned long long v=get_var_field(A,ini,min(ini+Wminusone,fin));
+  if(ini+W<=fin) v|=(unsigned long long)get_var_field(A,ini+W,fin)<<W;
+  return v;
+}
+
+/* The offset of a block is its rank in the combinatorial number system
+ * after mirroring the positions (q -> 62-q): sum of C(62-q_k,k) where q_k
+ * is the k-th one from the highest. Decoding recovers the ones from the
+ * lowest position up, so rank, access and select stop at the bit they need. */
+
+static inline unsigned long long encode63(unsigned long long block, uint c){
+  unsigned long long offset=0;
+  for(uint k=1;k<=c;k++){
+    uint q=msb64(block);
+    offset+=binomial[BLOCK_SIZE63-1-q][k];
+    block^=1ULL<<q;
+  }
+  return offset;
+}
+
+/** block with c ones and the given offset; only the positions <= last are
+ *  guaranteed, the ones above may be missing */
+static inline unsigned long long decode63(unsigned long long offset, uint c, uint last=BLOCK_SIZE63-1){
+  unsigned long long block=0;
+  for(uint q=0;c>0 && q<=last;q++){
+    uint p=BLOCK_SIZE63-1-q;
+    //the remaining ones are the highest positions
+    if(offset==0 || p+1==c){
+      block|=(MASK63>>(BLOCK_SIZE63-c))<<(BLOCK_SIZE63-c);
+      break;
+    }
+    if(offset>=binomial[p][c]){
+      block|=1ULL<<q;
+      offset-=binomial[p][c];
+      c--;
+    }
+  }
+  return block;
+}
+
+/** position of the x-th one (1<=x<=c) of the block with c ones and the
+ *  given offset */
+static inline uint select63(unsigned long long offset, uint c, uint x){
+  for(uint q=0;;q++){
+    uint p=BLOCK_SIZE63-1-q;
+    if(offset==0 || p+1==c)
+      return BLOCK_SIZE63-c+x-1;
+    if(offset>=binomial[p][c]){
+      if(--x==0) return q;
+      offset-=binomial[p][c];
+      c--;
+    }
+  }
+}
+
+unsigned long long static_bitsequence_rrr63::encode_block(unsigned long long block, uint c){
+  init_tables();
+  return encode63(block,c);
+}
+
+unsigned long long static_bitsequence_rrr63::decode_block(unsigned long long offset, uint c){
+  init_tables();
+  return decode63(offset,c);
+}
+
+uint static_bitsequence_rrr63::offset_bits(uint c){
+  init_tables();
+  return obits[c];
+}
+
+static_bitsequence_rrr63::static_bitsequence_rrr63(){
+  init_tables();
+  len=0;
+  ones=0;
+  nblocks=0;
+  C=NULL;
+  O=NULL;
+  O_bits_len=0;
+  sample_rate=DEFAULT_SAMPLING63;
+  nsamples=0;
+  Rs=Os=NULL;
+}
+
+static_bitsequence_rrr63::static_bitsequence_rrr63(uint *bitseq, uint n, uint _sample_rate){
+  init_tables();
+  len=n;
+  ones=0;
+  nblocks=(n+BLOCK_SIZE63-1)/BLOCK_SIZE63;
+  uint nc=uint_len(nblocks,CLASS_BITS63)+1;
+  C=new uint[nc];
+  for(uint i=0;i<nc;i++) C[i]=0;
+  // Table C
+  O_bits_len=0;
+  for(uint k=0;k<nblocks;k++){
+    uint c=popcount64(read_block(bitseq,n,k));
+    set_field(C,CLASS_BITS63,k,c);
+    ones+=c;
+    O_bits_len+=obits[c];
+  }
+  // Table O
+  uint no=O_bits_len/W64+2;
+  O=new unsigned long long[no];
+  for(uint i=0;i<no;i++) O[i]=0;
+  uint p=0;
+  for(uint k=0;k<nblocks;k++){
+    uint c=get_class(k);
+    set_bits64(O,p,obits[c],encode63(read_block(bitseq,n,k),c));
+    p+=obits[c];
+  }
+  Rs=Os=NULL;
+  create_sampling(_sample_rate);
+}
+
+static_bitsequence_rrr63::~static_bitsequence_rrr63() {
+  delete [] C;
+  delete [] O;
+  delete [] Rs;
+  delete [] Os;
+}
+
+void static_bitsequence_rrr63::create_sampling(uint _sample_rate){
+  sample_rate = _sample_rate ? _sample_rate : DEFAULT_SAMPLING63;
+  delete [] Rs;
+  delete [] Os;
+  nsamples=nblocks/sample_rate+2;
+  Rs=new uint[nsamples];
+  Os=new uint[nsamples];
+  uint sum=0, pos=0;
+  for(uint k=0;k<nblocks;k++){
+    if(k%sample_rate==0){
+      Rs[k/sample_rate]=sum;
+      Os[k/sample_rate]=pos;
+    }
+    uint c=get_class(k);
+    sum+=c;
+    pos+=obits[c];
+  }
+  for(uint s=nblocks ? (nblocks-1)/sample_rate+1 : 0;s<nsamples;s++){
+    Rs[s]=sum;
+    Os[s]=pos;
+  }
+}
+
+inline unsigned long long static_bitsequence_rrr63::get_block(uint c, uint p, uint last){
+  if(c==0) return 0;
+  if(c==BLOCK_SIZE63) return MASK63;
+  return decode63(get_bits64(O,p,obits[c]),c,last);
+}
+
+uint static_bitsequence_rrr63::rank1(uint i) {
+  if(i>=len) return ones;
+  uint b=i/BLOCK_SIZE63, s=b/sample_rate;
+  uint sum=Rs[s], p=Os[s];
+  for(uint k=s*sample_rate;k<b;k++){
+    uint c=get_class(k);
+    sum+=c;
+    p+=obits[c];
+  }
+  uint r=i%BLOCK_SIZE63;
+  return sum+popcount64(get_block(get_class(b),p,r) & ((2ULL<<r)-1));
+}
+
+uint static_bitsequence_rrr63::rank0(uint i) {
+  if(i>=len) return len-ones;
+  return i+1-rank1(i);
+}
+
+bool static_bitsequence_rrr63::access(uint i) {
+  uint b=i/BLOCK_SIZE63, s=b/sample_rate;
+  uint p=Os[s];
+  for(uint k=s*sample_rate;k<b;k++)
+    p+=obits[get_class(k)];
+  uint r=i%BLOCK_SIZE63;
+  return (get_block(get_class(b),p,r)>>r) & 1;
+}
+
+void static_bitsequence_rrr63::get_bitmap(uint *bitmap) {
+  uint p=0;
+  if(len) bitmap[uint_len(len,1)-1]=0;
+  for(uint k=0;k<nblocks;k++){
+    uint c=get_class(k);
+    unsigned long long block=get_block(c,p);
+    p+=obits[c];
+    //63 bits in two fields of at most W bits, cut at len
+    uint ini=k*BLOCK_SIZE63, fin=min(ini+BLOCK_SIZE63,len)-1;
+    uint mid=min(ini+Wminusone,fin);
+    set_var_field(bitmap,ini,mid,(uint)block & (~0u>>(Wminusone-(mid-ini))));
+    if(mid<fin) set_var_field(bitmap,mid+1,fin,(uint)(block>>W) & (~0u>>(Wminusone-(fin-mid-1))));
+  }
+}
+
+uint static_bitsequence_rrr63::select1(uint x) {
+  // returns i such that x=rank(i) && rank(i-1)<x or n if that i not exist
+  if(x==0) return (uint)-1;
+  if(x>ones) return len;
+  //last sample with less than x ones before it
+  uint l=0, r=(nblocks-1)/sample_rate;
+  while(l<r){
+    uint mid=(l+r+1)/2;
+    if(Rs[mid]<x) l=mid;
+    else r=mid-1;
+  }
+  uint acc=Rs[l], p=Os[l], k=l*sample_rate, c;
+  while(acc+(c=get_class(k))<x){
+    acc+=c;
+    p+=obits[c];
+    k++;
+  }
+  if(c==BLOCK_SIZE63) return k*BLOCK_SIZE63+x-acc-1;
+  return k*BLOCK_SIZE63+select63(get_bits64(O,p,obits[c]),c,x-acc);
+}
+
+uint static_bitsequence_rrr63::select0(uint x) {
+  // returns i such that x=rank_0(i) && rank_0(i-1)<x or n if that i not exist
+  if(x==0) return (uint)-1;
+  if(x>len-ones) return len;
+  uint l=0, r=(nblocks-1)/sample_rate;
+  while(l<r){
+    uint mid=(l+r+1)/2;
+    if(mid*sample_rate*BLOCK_SIZE63-Rs[mid]<x) l=mid;
+    else r=mid-1;
+  }
+  uint k=l*sample_rate, acc=k*BLOCK_SIZE63-Rs[l], p=Os[l], c;
+  while(acc+BLOCK_SIZE63-(c=get_class(k))<x){
+    acc+=BLOCK_SIZE63-c;
+    p+=obits[c];
+    k++;
+  }
+  return k*BLOCK_SIZE63+select64(~get_block(c,p) & MASK63,x-acc);
+}
+
+uint static_bitsequence_rrr63::SpaceRequirementInBits() {
+  return (uint_len(nblocks,CLASS_BITS63)+1)*W+(O_bits_len/W64+2)*W64+2*nsamples*W;
+}
+
+uint static_bitsequence_rrr63::size() {
+  return sizeof(static_bitsequence_rrr63)+SpaceRequirementInBits()/8;
+}
+
+int static_bitsequence_rrr63::save(FILE *f) {
+  uint wr = RRR63_HDR;
+  if (f == NULL) return 20;
+  if (fwrite (&wr,sizeof(uint),1,f) != 1) return 21;
+  if (fwrite (&len,sizeof(uint),1,f) != 1) return 21;
+  if (fwrite (&ones,sizeof(uint),1,f) != 1) return 21;
+  if (fwrite (&O_bits_len,sizeof(uint),1,f) != 1) return 21;
+  if (fwrite (&sample_rate,sizeof(uint),1,f) != 1) return 21;
+  uint nc=uint_len(nblocks,CLASS_BITS63)+1, no=O_bits_len/W64+2;
+  if (fwrite (C,sizeof(uint),nc,f) != nc) return 21;
+  if (fwrite (O,sizeof(unsigned long long),no,f) != no) return 21;
+  return 0;
+}
+
+static_bitsequence_rrr63 * static_bitsequence_rrr63::load(FILE *f) {
+  if (f == NULL) return NULL;
+  uint type, sample;
+  if (fread (&type,sizeof(uint),1,f) != 1 || type != RRR63_HDR) return NULL;
+  static_bitsequence_rrr63 * ret = new static_bitsequence_rrr63();
+  if (fread (&ret->len,sizeof(uint),1,f) != 1 ||
+      fread (&ret->ones,sizeof(uint),1,f) != 1 ||
+      fread (&ret->O_bits_len,sizeof(uint),1,f) != 1 ||
+      fread (&sample,sizeof(uint),1,f) != 1) {
+    delete ret;
+    return NULL;
+  }
+  ret->nblocks=(ret->len+BLOCK_SIZE63-1)/BLOCK_SIZE63;
+  uint nc=uint_len(ret->nblocks,CLASS_BITS63)+1, no=ret->O_bits_len/W64+2;
+  ret->C=new uint[nc];
+  ret->O=new unsigned long long[no];
+  if (fread (ret->C,sizeof(uint),nc,f) != nc ||
+      fread (ret->O,sizeof(unsigned long long),no,f) != no) {
+    delete ret;
+    return NULL;
+  }
+  ret->create_sampling(sample);
+  return ret;
+}
@@ -0,0 +1,93 @@
+/* static_bitsequence_rrr63.h
+   Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+
+   RRR compressed bitmap with 63-bit blocks and arithmetic offsets.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef _STATIC_BITSEQUENCE_RRR63_H
+#define _STATIC_BITSEQUENCE_RRR63_H
+
+#include <basics.h>
+#include <static_bitsequence.h>
+
+#define BLOCK_SIZE63 63
+#define CLASS_BITS63 6 //bits(BLOCK_SIZE63)
+#define DEFAULT_SAMPLING63 32
+
+/** Variant of static_bitsequence_rrr02 [1,2] with blocks of 63 bits. Each block
+ *  is stored as its class (number of ones, 6 bits) and its offset among the
+ *  C(63,class) blocks of that class, using ceil(log C(63,class)) bits. The
+ *  offsets are computed and decoded with the combinatorial number system
+ *  over a 64x64 table of binomial coefficients, decoding from the lowest
+ *  position up to the bit the query needs, so the universal table of
+ *  table_offset (2^BLOCK_SIZE entries) is not needed, and the redundancy per
+ *  block is much smaller than with 15-bit blocks on very skewed bitmaps.
+ *  Absolute ranks and offset positions are sampled every sample_rate blocks.
+ *
+ *  [1] R. Raman, V. Raman and S. Rao. Succinct indexable dictionaries with
+ *      applications to encoding $k$-ary trees and multisets. SODA02.
+ *  [2] F. Claude and G. Navarro. Practical Rank/Select over Arbitrary
+ *      Sequences. SPIRE08.
+ *
+ *  @author Carlos Bedregal
+ */
+class static_bitsequence_rrr63 : public static_bitsequence {
+private:
+  uint nblocks; //number of blocks
+  uint *C; //classes, CLASS_BITS63 each
+  unsigned long long *O; //offsets
+  uint O_bits_len; //bits used in O
+  uint sample_rate; //blocks between samples
+  uint nsamples; //entries in Rs and Os
+  uint *Rs; //ones before each sampled block
+  uint *Os; //position in O of each sampled block
+
+  static_bitsequence_rrr63();
+  void create_sampling(uint sample_rate);
+
+  /** class of block k */
+  inline uint get_class(uint k) { return get_field(C,CLASS_BITS63,k); }
+  /** bits of the block with class c and offset at position p of O, only
+   *  the positions up to last are guaranteed */
+  inline unsigned long long get_block(uint c, uint p, uint last=BLOCK_SIZE63-1);
+
+public:
+  static_bitsequence_rrr63(uint *bitseq, uint n, uint sample_rate=DEFAULT_SAMPLING63);
+  ~static_bitsequence_rrr63(); //destructor
+  virtual bool access(uint i);
+  virtual void get_bitmap(uint *bitmap);
+  virtual uint rank0(uint i);
+  virtual uint rank1(uint i);
+  virtual uint select0(uint x); // gives the position of the x:th 0.
+  virtual uint select1(uint x); // gives the position of the x:th 1.
+  uint SpaceRequirementInBits();
+  virtual uint size();
+
+  /*load-save functions*/
+  virtual int save(FILE *f);
+  static static_bitsequence_rrr63 * load(FILE * fp);
+
+  /** offset of a block with c ones among the blocks of its class */
+  static unsigned long long encode_block(unsigned long long block, uint c);
+  /** block with c ones and the given offset */
+  static unsigned long long decode_block(unsigned long long offset, uint c);
+  /** bits used by the offset of a block with c ones */
+  static uint offset_bits(uint c);
+};
+
+#endif
@@ -0,0 +1,126 @@
+/* benchbuild.cpp
+   Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+
+   Implementation of Compressed Representation of Permutations: Runs & SRuns.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include<iostream>
+#include<vector>
+#include<chrono>
+#include<cstdlib>
+#include<cstring>
+#include<algorithm>
+#include<unistd.h>
+#include<sys/wait.h>
+
+#include"bitseqflag.h"
+#include"theorem1.h"
+#include"theorem2.h"
+
+using namespace std;
+
+int bitseqFlag=BRW;
+
+/* permutation of about n values with about ro runs and SRuns of length srun:
+ * blocks of srun consecutive values in random order, sorted inside ro
+ * groups of blocks. Returns the number of values in n */
+int* createSweep(int& n, int ro, int srun){
+    int blocks=n/srun, i, j;
+    int *order=new int[blocks], *array;
+    for(i=0; i<blocks; i++) order[i]=i;
+    random_shuffle(order,order+blocks);
+    vector<int> cuts;
+    for(i=0; i<ro-1; i++) cuts.push_back(rand()%blocks);
+    cuts.push_back(0);
+    cuts.push_back(blocks);
+    sort(cuts.begin(),cuts.end());
+    for(i=0; i+1<(int)cuts.size(); i++) sort(order+cuts[i],order+cuts[i+1]);
+    n=blocks*srun;
+    array=new int[n];
+    for(i=0; i<blocks; i++)
+        for(j=0; j<srun; j++) array[i*srun+j]=order[i]*srun+j;
+    delete[]order;
+    return array;
+}
+
+/* builds the Theorem (1 or 2) of one configuration with the profile
+ * enabled, and prints its time and phases */
+int benchOne(int th, int n, int ro, int srun){
+    srand(n^ro^srun);
+    int* array=createSweep(n,ro,srun);
+    Permutation<int> p(array,n);
+    int runs=1;
+    for(int i=1; i<n; i++) runs+=array[i]<array[i-1];
+    long input=BuildProfile::peakRSS();
+    BuildProfile::reset();
+    BuildProfile::enabled=true;
+    chrono::steady_clock::time_point t0=chrono::steady_clock::now();
+    Theorem* t;
+    if(th==1){
+        p.findRuns();
+        t=new Theorem1(&p);
+    }
+    else t=new Theorem2(&p,true);
+    chrono::duration<double> elapsed=chrono::steady_clock::now()-t0;
+    BuildProfile::enabled=false;
+    cout<<"Theorem"<<th<<" n: "<<n<<" ro: "<<runs<<" tau: "<<n/srun<<" flag: "<<bitseqFlag
+        <<" s: "<<elapsed.count()<<" input MB: "<<input/1024.0<<" size MB: "<<t->size()/1048576.0<<endl;
+    BuildProfile::report(cout);
+    cout<<endl;
+    delete t;
+    delete[]array;
+    return 0;
+}
+
+/* comma separated list of ints */
+vector<int> parseList(const char* s){
+    vector<int> v;
+    for(const char* c=s; c && *c; c=strchr(c,',')){
+        if(*c==',') c++;
+        v.push_back(atoi(c));
+    }
+    return v;
+}
+
+/* construction phases of Theorem1 and Theorem2 over a sweep:
+ * HTBENCH [n,..] [ro,..] [srun,..] [bitseqFlag] [threads]
+ * tau is about n/srun. Each build runs in its own process, so the peak RSS
+ * reported is the one of that build */
+int main(int argc, char* argv[]){
+    vector<int> ns = parseList(argc>1 ? argv[1] : "1000000,10000000");
+    vector<int> ros = parseList(argc>2 ? argv[2] : "10,1000,100000");
+    vector<int> sruns = parseList(argc>3 ? argv[3] : "1,4,64");
+    bitseqFlag = argc>4 ? atoi(argv[4]) : BRW;
+    WaveletTree<int>::buildThreads = Permutation<int>::runThreads = argc>5 ? max(1,atoi(argv[5])) : 1;
+
+    for(size_t a=0; a<ns.size(); a++)
+        for(size_t b=0; b<ros.size(); b++)
+            for(size_t c=0; c<sruns.size(); c++)
+                for(int th=1; th<=2; th++){
+                    //too few blocks for the runs, or a single run (no tree)
+                    if(ns[a]/sruns[c]<2*ros[b] || ros[b]<2) continue;
+                    cout.flush();
+                    pid_t pid=fork();
+                    if(pid==0) return benchOne(th,ns[a],ros[b],sruns[c]);
+                    int status;
+                    waitpid(pid,&status,0);
+                    if(!WIFEXITED(status) || WEXITSTATUS(status)!=0)
+                        cout<<"Theorem"<<th<<" n: "<<ns[a]<<" ro: "<<ros[b]<<" srun: "<<sruns[c]<<" failed\n\n";
+                }
+    return 0;
+}
@@ -26,7 +26,9 @@
 
 using namespace std;
 
-/** Auxiliar class to handle binary nodes.
+/** Auxiliar class to handle binary nodes. The weight and the endpoints are
+ *  positions of the permutation, and pos the number of a run, of type T as
+ *  its values.
  *
  *  @author Carlos Bedregal
  */
@@ -34,18 +36,18 @@ using namespace std;
 template <class T>
 class BNode{
     public:
-    int w; //weight
-    int pos; //position
+    T w; //weight
+    T pos; //position
     bool type; //0=external, 1=internal
-    int endpoint[2];
+    T endpoint[2];
     BNode* children[2];
     T* obj;
 
     BNode();
-    BNode(int v, int p, int t, T* o);
+    BNode(T v, T p, int t, T* o);
     ~BNode(){};
     void print();
-    void setEndpoints(int start, int end);
+    void setEndpoints(T start, T end);
     void recPrint(int level=0);
 };
 
@@ -60,7 +62,7 @@ BNode<T>::BNode(){
 }
 
 template <class T>
-BNode<T>::BNode(int v, int p, int t, T* o){
+BNode<T>::BNode(T v, T p, int t, T* o){
     w=v;
     obj=o;
     pos=p;
@@ -70,7 +72,7 @@ BNode<T>::BNode(int v, int p, int t, T* o){
 }
 
 template <class T>
-void BNode<T>::setEndpoints(int start, int end){
+void BNode<T>::setEndpoints(T start, T end){
     endpoint[0]=start;
     endpoint[1]=end;
 }
@@ -0,0 +1,39 @@
+/* bitseqflag.h
+   Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+
+   Implementation of Compressed Representation of Permutations: Runs & SRuns.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef BITSEQFLAG_H_INCLUDED
+#define BITSEQFLAG_H_INCLUDED
+
+//bitsequences of the nodes of the wavelet trees (values of bitseqFlag)
+#define BRW 0
+#define RRRL 1
+#define RRR 2
+#define BRW64 3
+#define INTERLEAVED 4
+#define RRR63 5
+#define ADAPTIVE 6 //per node, see WTNode::bitseqChoice
+
+/* bitsequence of the nodes built from now on, read by WTNode::bitseqCreator
+ * and kept by each Theorem1 (bitseqType). Defined by each program, BRW by
+ * default */
+extern int bitseqFlag;
+
+#endif // BITSEQFLAG_H_INCLUDED
@@ -0,0 +1,68 @@
+/* buildprofile.cpp
+   Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+
+   Implementation of Compressed Representation of Permutations: Runs & SRuns.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include<iomanip>
+#include<sys/resource.h>
+#include"buildprofile.h"
+
+bool BuildProfile::enabled = false;
+const char* BuildProfile::names[PH_COUNT] = {"runs","th2.R","th2.Rinv","th2.sruns",
+    "ht.combination","ht.levels","ht.recombination","wt.build","wt.merge","bitseq"};
+atomic<long long> BuildProfile::nanos[PH_COUNT];
+atomic<long long> BuildProfile::calls[PH_COUNT];
+atomic<long long> BuildProfile::allocs[PH_COUNT];
+atomic<long long> BuildProfile::bytes[PH_COUNT];
+atomic<long long> BuildProfile::rssKB[PH_COUNT];
+atomic<bool> BuildProfile::rssSampled[PH_COUNT];
+
+void BuildProfile::reset(){
+    for(int ph=0; ph<PH_COUNT; ph++){
+        nanos[ph]=calls[ph]=allocs[ph]=bytes[ph]=rssKB[ph]=0;
+        rssSampled[ph]=false;
+    }
+}
+
+/* peak resident set size of the process, in KB */
+long BuildProfile::peakRSS(){
+    struct rusage usage;
+    getrusage(RUSAGE_SELF,&usage);
+    return usage.ru_maxrss;
+}
+
+/* one line per phase that ran: calls, seconds, allocations, MB allocated and
+ * MB of growth of the peak RSS (- if not sampled) */
+void BuildProfile::report(ostream& out){
+    ios::fmtflags flags=out.flags();
+    streamsize precision=out.precision();
+    out<<left<<setw(18)<<"phase"<<right<<setw(10)<<"calls"<<setw(10)<<"s"<<setw(10)<<"allocs"
+       <<setw(10)<<"MB"<<setw(10)<<"peakMB"<<endl;
+    for(int ph=0; ph<PH_COUNT; ph++){
+        if(!calls[ph] && !allocs[ph]) continue;
+        out<<left<<setw(18)<<names[ph]<<right<<setw(10)<<calls[ph]
+           <<setw(10)<<fixed<<setprecision(3)<<nanos[ph]/1e9<<setw(10)<<allocs[ph]
+           <<setw(10)<<setprecision(1)<<bytes[ph]/1048576.0<<setw(10);
+        if(rssSampled[ph]) out<<rssKB[ph]/1024.0<<endl;
+        else out<<"-"<<endl;
+    }
+    out<<"peak RSS MB: "<<setprecision(1)<<peakRSS()/1024.0<<endl;
+    out.flags(flags);
+    out.precision(precision);
+}
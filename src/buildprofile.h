@@ -0,0 +1,110 @@
+/* buildprofile.h
+   Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+
+   Implementation of Compressed Representation of Permutations: Runs & SRuns.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef BUILDPROFILE_H_INCLUDED
+#define BUILDPROFILE_H_INCLUDED
+
+#include<iostream>
+#include<chrono>
+#include<atomic>
+
+using namespace std;
+
+//phases of the construction
+#define PH_RUNS 0 //Permutation::findRuns, findSRuns and findHRuns
+#define PH_TH2_R 1 //Theorem2: bitmap R
+#define PH_TH2_RINV 2 //Theorem2: heads of the SRuns and bitmap Rinv
+#define PH_TH2_SRUNS 3 //Theorem2: permutation of the SRuns
+#define PH_HT_COMBINATION 4 //HuTucker phases
+#define PH_HT_LEVELS 5
+#define PH_HT_RECOMBINATION 6
+#define PH_WT_BUILD 7 //WaveletTree::build, the merges and bitsequences below
+#define PH_WT_MERGE 8 //WaveletTree::recBuild merges
+#define PH_BITSEQ 9 //bitsequence constructors
+#define PH_COUNT 10
+
+/** Time and allocations of each phase of the construction, reported by the
+ *  constructors while enabled is set (it is not by default, and then the
+ *  reports cost a branch). A phase is timed with a BuildTimer in its scope;
+ *  the time of phases run by several threads at once (the merges and the
+ *  bitsequences of a parallel build) is added over the threads. Besides the
+ *  time, each phase accumulates the allocations (count and bytes) reported
+ *  with alloc for its main buffers, and the growth of the peak RSS of the
+ *  process while it runs. The RSS is not sampled by the timers of a single
+ *  node, which would slow down trees of many runs; their growth is counted
+ *  in wt.build.
+ *
+ *  @author Carlos Bedregal
+ */
+class BuildProfile{
+    public:
+    static bool enabled;
+    static const char* names[PH_COUNT];
+    static atomic<long long> nanos[PH_COUNT];
+    static atomic<long long> calls[PH_COUNT];
+    static atomic<long long> allocs[PH_COUNT];
+    static atomic<long long> bytes[PH_COUNT];
+    static atomic<long long> rssKB[PH_COUNT]; //growth of the peak RSS
+    static atomic<bool> rssSampled[PH_COUNT];
+
+    static void reset();
+    static inline void alloc(int phase, size_t n){
+        if(!enabled) return;
+        allocs[phase]++;
+        bytes[phase]+=n;
+    }
+    static long peakRSS();
+    static void report(ostream& out);
+};
+
+/** Adds the time (and the peak RSS growth) of its scope, or until stop, to a
+ *  phase of BuildProfile.
+ *
+ *  @author Carlos Bedregal
+ */
+class BuildTimer{
+    int phase; //-1 if the profile is disabled
+    long rss; //-1 if not sampled
+    chrono::steady_clock::time_point start;
+
+    public:
+    BuildTimer(int phase, bool sampleRSS=true){
+        this->phase = BuildProfile::enabled ? phase : -1;
+        if(this->phase<0) return;
+        rss = sampleRSS ? BuildProfile::peakRSS() : -1;
+        start = chrono::steady_clock::now();
+    }
+    ~BuildTimer(){ stop(); }
+
+    void stop(){
+        if(phase<0) return;
+        BuildProfile::nanos[phase] += chrono::duration_cast<chrono::nanoseconds>(
+                                          chrono::steady_clock::now()-start).count();
+        BuildProfile::calls[phase]++;
+        if(rss>=0){
+            BuildProfile::rssKB[phase] += BuildProfile::peakRSS()-rss;
+            BuildProfile::rssSampled[phase] = true;
+        }
+        phase=-1;
+    }
+};
+
+#endif // BUILDPROFILE_H_INCLUDED
@@ -23,15 +23,70 @@
 #define HUTUCKER_H_INCLUDED
 
 #include <iostream>
+#include <cstdlib>
+#include <limits>
+#include <type_traits>
 
 #include "permutation.h"
 #include "binarytrie.h"
 
 using namespace std;
 
-/** Auxiliar class to build a OABT using a variant of Hu-Tucker algorithm showed in [1].
+//children of each node in the heap of segments
+#define HT_ARITY 4
+
+/** Candidate pair of the combination phase: the two lightest nodes of a
+ *  segment, ordered by weight and then by the positions of the pair.
+ */
+template <class T>
+struct HTPair{
+    typename make_unsigned<T>::type w; //weight of the pair, it fits as the weights are T
+    T i, j; //positions of its left and right nodes
+    T seg; //segment of the pair
+    inline bool operator<(const HTPair& o) const{
+        if(w!=o.w) return w<o.w;
+        if(i!=o.i) return i<o.i;
+        return j<o.j;
+    }
+};
+
+/** Node of the combination phase, with its links in the leftist heap of the
+ *  merged nodes of its segment.
+ */
+template <class T>
+struct HTNode{
+    T w; //weight
+    T pos; //position in the sequence (the one of its left node)
+    T l, r; //children in the heap, -1 if none
+    T d; //distance to a null child
+};
+
+/** Segment between two consecutive leaves still in the sequence.
+ */
+template <class T>
+struct HTSeg{
+    T prev, next; //leaves before and after (next ends the segment)
+    T heap; //heap of its merged nodes, -1 if empty
+    T slot; //slot in the heap of segments, -1 if not there
+};
+
+/** Auxiliar class to build a OABT using the Hu-Tucker algorithm showed in [1].
+ *
+ *  The combination phase runs in O(ro log ro) as in [2]: the leaves
+ *  (square nodes) still in the sequence split it into segments, the merged
+ *  (circular) nodes of each segment are kept in a leftist heap, and the
+ *  segments in a binary heap by their lightest pair. When a leaf is merged
+ *  the heaps of its two segments are melded. Ties are broken by the leftmost
+ *  pair, and the levels of the leaves are rebuilt into the alphabetic tree by
+ *  recombination.
+ *
+ *  The number of runs, and the numbers of the nodes, are of the signed
+ *  type T of the values (-1 is the null node), so HuTucker<long long>
+ *  takes more than 2^31 runs.
  *
  *  [1] D. E. Knuth. Art of Computer Programming, Vol. 3 (2nd Edition)
+ *  [2] T. C. Hu and A. C. Tucker. Optimal Computer Search Trees and
+ *      Variable-Length Alphabetical Codes. SIAM J. Appl. Math. 1971.
  *
  *  @author Carlos Bedregal
  */
@@ -39,44 +94,78 @@ using namespace std;
 template <class T>
 class HuTucker{
     public:
+    typedef typename make_unsigned<T>::type Index;
+
     BNode<T>** seq;
     BNode<T>* root;
-    int* levels;
-    int start;
-    int end;
-    int len;
-    int weight;
+    T* levels;
+    T start;
+    T end;
+    T len;
+    T weight;
+
+    private:
+    //nodes of the combination phase: 1..len are the leaves, 0 and len+1
+    //are sentinels at both ends, and the merged nodes follow
+    HTNode<T>* nd;
+    T* parent; //merged node created from each node
+    //segment s starts at leaf s
+    HTSeg<T>* sg;
+    //heap of the segments by their lightest pair, HT_ARITY children per
+    //node so they share a cache line
+    HTPair<T>* pairs;
+    T npairs;
+
+    inline bool lighter(T a, T b){
+        return nd[a].w<nd[b].w || (nd[a].w==nd[b].w && nd[a].pos<nd[b].pos);
+    }
+    T meld(T a, T b);
+    bool bestPair(T s, T& x, T& y);
+    void updatePair(T s);
+    void removePair(T s);
+    void siftUp(T k, HTPair<T> p);
+    void siftDown(T k, HTPair<T> p);
+    void removeSquare(T q);
+    static void checkLength(unsigned long long ro);
 
     public:
     HuTucker(Permutation<T>* p);
-    HuTucker(T* array, int szArray);
+    HuTucker(T* array, Index szArray);
     ~HuTucker();
     BNode<T>* merge(BNode<T>* l, BNode<T>* r);
-    int getPosMin();
-    void remove(int &pos);
-    int findPosCompatible(int& pmin);
     void combination();
     void levelAssignment();
-    void recLevelAssign(BNode<T>* curr);
     void recombination();
     void print();
     void printLevels();
 };
 
+/* the 2ro+1 nodes of the combination phase are numbered with T: more runs
+ * than that (above 2^30 for int) take HuTucker<long long> */
+template <class T>
+void HuTucker<T>::checkLength(unsigned long long ro){
+    if(ro>(unsigned long long)((numeric_limits<T>::max)()/2)){
+        cout<<"@HuTucker(): "<<ro<<" runs, too many for the type of the values\n";
+        exit(-1);
+    }
+}
+
 template <class T>
 HuTucker<T>::HuTucker(Permutation<T>* p){
     #ifdef PRINT
         cout<<"- Building HuTucker: "<<p->ro<<" runs\n";
     #endif //PRINT
+    checkLength(p->ro);
     start=0;
     root=0;
     weight=0;
     end=p->ro-1;
     len=p->ro;
     seq=new BNode<T>*[p->ro];
-    levels=new int[p->ro];
+    levels=new T[p->ro];
 
-    for(int i=start, point=start; i<=end; i++){
+    T point=start;
+    for(T i=start; i<=end; i++){
         seq[i]=new BNode<T>(p->Runs[i],i,0,&(p->Runs[i]));
         seq[i]->setEndpoints(point,point+(p->Runs[i])-1);
         point=point+(p->Runs[i]);
@@ -88,19 +177,21 @@ HuTucker<T>::HuTucker(Permutation<T>* p){
 }
 
 template <class T>
-HuTucker<T>::HuTucker(T* array, int szArray){
+HuTucker<T>::HuTucker(T* array, Index szArray){
     #ifdef PRINT
         cout<<"- Building HuTucker: "<<szArray<<" runs ";
     #endif //PRINT
+    checkLength(szArray);
     start=0;
     root=0;
     weight=0;
     end=szArray-1;
     len=szArray;
     seq=new BNode<T>*[szArray];
-    levels=new int[szArray];
+    levels=new T[szArray];
 
-    for(int i=start, point=start; i<=end; i++){
+    T point=start;
+    for(T i=start; i<=end; i++){
         seq[i]=new BNode<T>(array[i],i,0,&(array[i]));
         seq[i]->setEndpoints(point,point+(array[i])-1);
         point=point+(array[i]);
@@ -113,7 +204,7 @@ HuTucker<T>::HuTucker(T* array, int szArray){
 
 template <class T>
 HuTucker<T>::~HuTucker(){
-    for(int i=start; i<=end; i++)
+    for(T i=start; i<=end; i++)
         delete seq[i];
     delete[]seq;
     delete[]levels;
@@ -129,95 +220,180 @@ BNode<T>* HuTucker<T>::merge(BNode<T>* l, BNode<T>* r){
 }
 
 template <class T>
-int HuTucker<T>::getPosMin(){
-    int min=start;
-    //sequential search of the minimum element
-    for(int i=min+1; i<=end; i++)
-        if(seq[min]->w>seq[i]->w)
-            min=i ;
-    return min;
+T HuTucker<T>::meld(T a, T b){
+    if(a<0) return b;
+    if(b<0) return a;
+    if(lighter(b,a)){ T t=a; a=b; b=t; }
+    HTNode<T>& n=nd[a];
+    n.r=meld(n.r,b);
+    if(n.l<0 || nd[n.l].d<nd[n.r].d){ T t=n.l; n.l=n.r; n.r=t; }
+    n.d = n.r<0 ? 1 : nd[n.r].d+1;
+    return a;
 }
 
+/* the two lightest nodes of segment s, x to the left of y. They are taken
+ * among its two leaves and the two lightest merged nodes, all of them
+ * compatible */
 template <class T>
-void HuTucker<T>::remove(int &pos){
-    seq[pos]=0;
-    //sequential update of elements
-    for(int i=pos; i<end; i++)
-       seq[i]=seq[i+1];
-    seq[end]=0;
-    end--;
+bool HuTucker<T>::bestPair(T s, T& x, T& y){
+    T cand[4];
+    int nc=0;
+    if(s!=0) cand[nc++]=s;
+    if(sg[s].next!=len+1) cand[nc++]=sg[s].next;
+    T h=sg[s].heap;
+    if(h>=0){
+        T l=nd[h].l, r=nd[h].r;
+        cand[nc++]=h;
+        if(l>=0 && (r<0 || lighter(l,r))) cand[nc++]=l;
+        else if(r>=0) cand[nc++]=r;
+    }
+    if(nc<2) return false;
+    x=-1; y=-1;
+    for(int k=0; k<nc; k++){
+        T c=cand[k];
+        if(x<0 || lighter(c,x)){ y=x; x=c; }
+        else if(y<0 || lighter(c,y)) y=c;
+    }
+    if(nd[x].pos>nd[y].pos){ T t=x; x=y; y=t; }
+    return true;
 }
 
+/* places p in the heap of segments from slot k */
 template <class T>
-int HuTucker<T>::findPosCompatible(int& pmin){
-    int pcom, minleft, minright;
-    minleft=minright=pmin;
-    //find towards left end of pmin's huffman seq
-    if(pmin!=start){
-        minleft=pmin-1;
-        for(int left=pmin-2; left>=start && seq[left+1]->type!=0; left--){
-            if(seq[minleft]->w >= seq[left]->w) minleft=left;
-        }
-    }
-    //find towards right end of pmin's huffman seq
-    if(pmin!=end){
-        minright=pmin+1;
-        for(int right=pmin+2; right<=end && seq[right-1]->type!=0; right++){
-            if(seq[minright]->w > seq[right]->w) minright=right;
-        }
+void HuTucker<T>::siftUp(T k, HTPair<T> p){
+    while(k>0 && p<pairs[(k-1)/HT_ARITY]){
+        pairs[k]=pairs[(k-1)/HT_ARITY];
+        sg[pairs[k].seg].slot=k;
+        k=(k-1)/HT_ARITY;
     }
-    //min{minleft,minright}
-    if(minleft==pmin) pcom=minright;
-    else{
-        if(minright==pmin) pcom=minleft;
-        else pcom=(seq[minleft]->w<=seq[minright]->w) ? minleft : minright;
-    }
-    return pcom;
+    pairs[k]=p;
+    sg[p.seg].slot=k;
 }
 
 template <class T>
-void HuTucker<T>::combination(){
-    int pmin=0, pcom, temp, lastEnd=end;
-    while(start!=end){
-        pmin = getPosMin();
-        pcom = findPosCompatible(pmin);
+void HuTucker<T>::siftDown(T k, HTPair<T> p){
+    for(T c=HT_ARITY*k+1; c<npairs; k=c, c=HT_ARITY*k+1){
+        T last = c+HT_ARITY<npairs ? c+HT_ARITY : npairs;
+        for(T q=c+1; q<last; q++)
+            if(pairs[q]<pairs[c]) c=q;
+        if(!(pairs[c]<p)) break;
+        pairs[k]=pairs[c];
+        sg[pairs[k].seg].slot=k;
+    }
+    pairs[k]=p;
+    sg[p.seg].slot=k;
+}
 
-        if(pmin > pcom){ temp=pmin; pmin=pcom; pcom=temp; }
+/* recomputes the lightest pair of segment s and its place in the heap */
+template <class T>
+void HuTucker<T>::updatePair(T s){
+    T x, y;
+    if(!bestPair(s,x,y)){ removePair(s); return; }
+    typedef typename make_unsigned<T>::type U;
+    HTPair<T> p = {(U)nd[x].w+(U)nd[y].w, nd[x].pos, nd[y].pos, s};
+    T k=sg[s].slot;
+    if(k<0) siftUp(npairs++,p);
+    else if(p<pairs[k]) siftUp(k,p);
+    else siftDown(k,p);
+}
 
-        seq[pmin]=merge(seq[pmin],seq[pcom]);
-        remove(pcom);
-    }
-    end=lastEnd;
-    root=seq[pmin];
+template <class T>
+void HuTucker<T>::removePair(T s){
+    T k=sg[s].slot;
+    if(k<0) return;
+    sg[s].slot=-1;
+    if(k==--npairs) return;
+    HTPair<T> p=pairs[npairs];
+    if(p<pairs[k]) siftUp(k,p);
+    else siftDown(k,p);
 }
 
+/* the leaf q leaves the sequence, its segment joins the one to its left */
 template <class T>
-void HuTucker<T>::levelAssignment(){
-    recLevelAssign(root);
+void HuTucker<T>::removeSquare(T q){
+    T p=sg[q].prev, n=sg[q].next;
+    sg[p].heap=meld(sg[p].heap,sg[q].heap);
+    sg[q].heap=-1;
+    removePair(q);
+    sg[p].next=n;
+    sg[n].prev=p;
 }
 
 template <class T>
-void HuTucker<T>::recLevelAssign(BNode<T>* curr){
-    static int lvl=0;
-    if(curr->type==1){//internal node
-        weight++; //counter of internal nodes
-        lvl++;
-        recLevelAssign(curr->children[0]);
-        recLevelAssign(curr->children[1]);
-        delete curr;
-        lvl--;
+void HuTucker<T>::combination(){
+    BuildTimer timer(PH_HT_COMBINATION);
+    T nodes=2*len+1;
+    nd=new HTNode<T>[nodes];
+    parent=new T[nodes];
+    sg=new HTSeg<T>[len+2];
+    pairs=new HTPair<T>[len+2];
+    BuildProfile::alloc(PH_HT_COMBINATION,nodes*(sizeof(HTNode<T>)+sizeof(T))+(len+2)*(sizeof(HTSeg<T>)+sizeof(HTPair<T>)));
+    npairs=0;
+
+    for(T k=0; k<=len+1; k++){
+        nd[k].w = (k==0 || k==len+1) ? 0 : seq[k-1]->w;
+        nd[k].pos=k;
+        parent[k]=-1;
+        sg[k].prev=k-1;
+        sg[k].next=k+1;
+        sg[k].heap=-1;
+        sg[k].slot=-1;
     }
-    else{//leaf node
-        levels[curr->pos]=lvl;
-        seq[curr->pos]=curr;
+    for(T s=1; s<len; s++) updatePair(s);
+
+    T c=len+2;
+    for(T m=0; m<len-1; m++, c++){
+        T s=pairs[0].seg, x, y;
+        bestPair(s,x,y);
+        nd[c].w=nd[x].w+nd[y].w;
+        nd[c].pos=nd[x].pos;
+        parent[c]=-1;
+        parent[x]=parent[y]=c;
+
+        //merged nodes are the lightest ones of the heap of s
+        int circles = (x>len+1) + (y>len+1);
+        while(circles--) sg[s].heap=meld(nd[sg[s].heap].l,nd[sg[s].heap].r);
+        //leaves leave the sequence, the right one first
+        T seg=s;
+        if(y==sg[s].next) removeSquare(y);
+        if(x==s){ seg=sg[s].prev; removeSquare(s); }
+
+        nd[c].l=nd[c].r=-1; nd[c].d=1;
+        sg[seg].heap=meld(sg[seg].heap,c);
+        updatePair(seg);
     }
+
+    delete[]nd;
+    delete[]sg;
+    delete[]pairs;
+}
+
+/* level of each leaf in the tree of the combination phase. Merged nodes are
+ * created after their children, so a pass from the last one (the root)
+ * gives the depths without traversing that tree, which can be as deep as
+ * the number of leaves */
+template <class T>
+void HuTucker<T>::levelAssignment(){
+    BuildTimer timer(PH_HT_LEVELS);
+    T nodes=2*len+1;
+    T* depth=new T[nodes];
+    BuildProfile::alloc(PH_HT_LEVELS,nodes*sizeof(T));
+    for(T c=len+len; c>=len+2; c--)
+        depth[c] = parent[c]<0 ? 0 : depth[parent[c]]+1;
+    for(T k=1; k<=len; k++)
+        levels[k-1] = parent[k]<0 ? 0 : depth[parent[k]]+1;
+    weight=len-1; //internal nodes
+    delete[]depth;
+    delete[]parent;
 }
 
 template <class T>
 void HuTucker<T>::recombination(){
-    int* stack = new int[len];
-    int pos=0;
-    int cont=0;
+    BuildTimer timer(PH_HT_RECOMBINATION);
+    T* stack = new T[len];
+    BuildProfile::alloc(PH_HT_RECOMBINATION,len*sizeof(T)+(len-1)*sizeof(BNode<T>));
+    T pos=0;
+    T cont=0;
     stack[pos]=cont++;
     while(cont<len){
         pos++;
@@ -235,7 +411,7 @@ void HuTucker<T>::recombination(){
 
 template <class T>
 void HuTucker<T>::print(){
-    int i;
+    T i;
     cout<<"Seq["<<len<<":"<<start<<","<<end<<"]\n";
     for(i=0; i<len; i++)
         if(seq[i]) seq[i]->print();
@@ -248,7 +424,7 @@ void HuTucker<T>::print(){
 
 template <class T>
 void HuTucker<T>::printLevels(){
-    int i;
+    T i;
     cout<<"Levels: ";
     for(i=0; i<len; i++)
         cout<<levels[i]<<" ";
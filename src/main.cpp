@@ -1,20 +1,22 @@
 #include<iostream>
 #include<fstream>
 #include<vector>
+#include<thread>
+#include<chrono>
+#include<cstdlib>
+#include<algorithm>
 
 #define PRINT
 
-#define BRW 0
-#define RRRL 1
-#define RRR 2
-
-int bitseqFlag=BRW;
-
+#include"bitseqflag.h"
 #include"theorem1.h"
 #include"theorem2.h"
+#include"wtexternal.h"
 
 using namespace std;
 
+int bitseqFlag=BRW;
+
 void printArray(int* array, int n){
     cout<<"["<<n<<"]: ";
     for(int i=0; i<n;  i++){
@@ -46,9 +48,203 @@ int* createArray(int ro, int* runs,int &size){
     return array;
 }
 
+/* runs nq queries of th (piInv if inv) split among nt threads sharing th,
+ * returns the elapsed seconds and the sum of the answers in check */
+double queryThreads(Theorem* th, uint* Q, uint nq, int nt, bool inv, unsigned long long& check){
+    vector<thread> pool;
+    vector<unsigned long long> sums(nt,0);
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    for(int t=0; t<nt; t++)
+        pool.push_back(thread([=,&sums](){
+            unsigned long long s=0;
+            for(uint q=(unsigned long long)nq*t/nt; q<(unsigned long long)nq*(t+1)/nt; q++)
+                s += inv ? th->piInv(Q[q]) : th->pi(Q[q]);
+            sums[t]=s;
+        }));
+    for(int t=0; t<nt; t++) pool[t].join();
+    chrono::duration<double> elapsed = chrono::steady_clock::now()-t0;
+    check=0;
+    for(int t=0; t<nt; t++) check+=sums[t];
+    return elapsed.count();
+}
+
+/* permutation of n elements made of ro blocks of consecutive values placed in
+ * random order, so it has about ro Runs and SRuns */
+int* createBlocks(int n, int ro){
+    int *array = new int[n], *cuts = new int[ro+1], *order = new int[ro];
+    int i, j, k;
+    for(i=0; i<n; i++) array[i]=i;
+    for(i=1; i<ro; i++) cuts[i]=rand()%n;
+    cuts[0]=0; cuts[ro]=n;
+    sort(cuts+1,cuts+ro);
+    for(i=0; i<ro; i++) order[i]=i;
+    for(i=ro-1; i>0; i--) swap(order[i],order[rand()%(i+1)]);
+    for(i=0,k=0; i<ro; i++)
+        for(j=cuts[order[i]]; j<cuts[order[i]+1]; j++)
+            array[k++]=j;
+    delete[] cuts;
+    delete[] order;
+    return array;
+}
+
+/* multi-threaded throughput of pi and piInv over one shared structure:
+ * HTWT -t threads [n] [ro] [queries]. Threads go 1,2,4..threads, and each
+ * result is checked against the one of a single thread */
+int benchThreads(int maxThreads, int n, int ro, uint nq){
+    //each construction sorts the array of its permutation
+    int *array = createBlocks(n,ro), *array2 = new int[n];
+    copy(array,array+n,array2);
+    Permutation <int> p1 (array,n), p2 (array2,n);
+    p1.findRuns();
+    p2.findRuns();
+
+    Theorem* ths[2] = {new Theorem1(&p1), new Theorem2(&p2)};
+    const char* names[2] = {"Theorem1","Theorem2"};
+    uint* Q = new uint[nq];
+    for(uint q=0; q<nq; q++) Q[q] = rand()%n;
+
+    for(int k=0; k<2; k++){
+        for(int inv=0; inv<2; inv++){
+            unsigned long long check1=0, check;
+            for(int nt=1; ; nt=(2*nt<maxThreads ? 2*nt : maxThreads)){
+                double secs = queryThreads(ths[k],Q,nq,nt,inv,check);
+                if(nt==1) check1=check;
+                cout<<names[k]<<(inv?" piInv":" pi")<<" threads: "<<nt<<" Mq/s: "<<nq/secs/1e6
+                    <<(check==check1 ? "" : " MISMATCH")<<endl;
+                if(check!=check1) return -1;
+                if(nt>=maxThreads) break;
+            }
+        }
+        delete ths[k];
+    }
+    delete[] Q;
+    delete[] array;
+    delete[] array2;
+    return 0;
+}
+
+/* construction time of Theorem1 and Theorem2 with 1,2,4..threads threads:
+ * HTWT -b threads [n] [ro]. Each result is checked against the one built by
+ * a single thread */
+int benchBuild(int maxThreads, int n, int ro){
+    int *array = createBlocks(n,ro), *copyArray = new int[n];
+    int *out = new int[n], *out1 = new int[n];
+    const char* names[2] = {"Theorem1","Theorem2"};
+
+    for(int k=0; k<2; k++){
+        for(int nt=1; ; nt=(2*nt<maxThreads ? 2*nt : maxThreads)){
+            WaveletTree<int>::buildThreads = nt;
+            Permutation<int>::runThreads = nt;
+            //each construction sorts the array of its permutation
+            copy(array,array+n,copyArray);
+            Permutation <int> p (copyArray,n);
+            chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+            Theorem* th;
+            if(k==0){
+                p.findRuns();
+                th = new Theorem1(&p);
+            }
+            else th = new Theorem2(&p);
+            chrono::duration<double> elapsed = chrono::steady_clock::now()-t0;
+            th->decode(nt==1 ? out1 : out);
+            bool ok = nt==1 || equal(out,out+n,out1);
+            cout<<names[k]<<" build threads: "<<nt<<" s: "<<elapsed.count()
+                <<(ok ? "" : " MISMATCH")<<endl;
+            delete th;
+            if(!ok) return -1;
+            if(nt>=maxThreads) break;
+        }
+    }
+    WaveletTree<int>::buildThreads = 1;
+    Permutation<int>::runThreads = 1;
+    delete[] array;
+    delete[] copyArray;
+    delete[] out;
+    delete[] out1;
+    return 0;
+}
+
+/* builds the Theorem1 and Theorem2 with positions of type T of array, and
+ * times nq queries of pi and piInv on each one. The sums of the answers go
+ * to check, to compare the types */
+template <class T>
+int benchIndexType(int* array, int n, uint* Q, uint nq, unsigned long long* check){
+    const char* names[2] = {"Theorem1","Theorem2"};
+    T* copyArray = new T[n];
+    for(int k=0; k<2; k++){
+        copy(array,array+n,copyArray);
+        Permutation<T> p (copyArray,n);
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        TheoremT<T>* th;
+        if(k==0){
+            p.findRuns();
+            th = new Theorem1T<T>(&p);
+        }
+        else th = new Theorem2T<T>(&p);
+        chrono::duration<double> build = chrono::steady_clock::now()-t0;
+        cout<<names[k]<<" "<<8*sizeof(T)<<"-bit build s: "<<build.count()
+            <<" size MB: "<<th->size()/1048576.0;
+        for(int inv=0; inv<2; inv++){
+            unsigned long long s=0;
+            t0 = chrono::steady_clock::now();
+            for(uint q=0; q<nq; q++)
+                s += inv ? th->piInv(Q[q]) : th->pi(Q[q]);
+            chrono::duration<double> elapsed = chrono::steady_clock::now()-t0;
+            cout<<(inv ? " piInv" : " pi")<<" Mq/s: "<<nq/elapsed.count()/1e6;
+            check[2*k+inv]=s;
+        }
+        cout<<endl;
+        delete th;
+    }
+    delete[] copyArray;
+    return 0;
+}
+
+/* construction and queries with 32-bit (int) and 64-bit (long long)
+ * positions over the same permutation: HTWT -l [n] [ro] [queries] */
+int benchIndex(int n, int ro, uint nq){
+    int* array = createBlocks(n,ro);
+    uint* Q = new uint[nq];
+    for(uint q=0; q<nq; q++) Q[q] = rand()%n;
+    unsigned long long check32[4], check64[4];
+    benchIndexType<int>(array,n,Q,nq,check32);
+    benchIndexType<long long>(array,n,Q,nq,check64);
+    bool ok = equal(check32,check32+4,check64);
+    if(!ok) cout<<"MISMATCH"<<endl;
+    delete[] Q;
+    delete[] array;
+    return ok ? 0 : -1;
+}
+
 int main(int argc, char* argv[]){
 
-	int *array, size;
+    if(argc>2 && !strcmp(argv[1],"-t"))
+        return benchThreads(max(1,atoi(argv[2])),
+                            argc>3 ? atoi(argv[3]) : 1000000,
+                            argc>4 ? atoi(argv[4]) : 1000,
+                            argc>5 ? atoi(argv[5]) : 1000000);
+    //HTWT -e input output [bufferMB] [64]: Theorem1 of the int values in
+    //input (long long values if 64) saved into output (and output.idx)
+    //without loading them in memory
+    if(argc>3 && !strcmp(argv[1],"-e")){
+        size_t bytes = argc>4 ? (size_t)atoi(argv[4])<<20 : WTEXT_BUFFER;
+        if(argc>5 && atoi(argv[5])==64){
+            WTExternalBuilderT<long long> builder(argv[2],bytes);
+            return builder.build(argv[3]);
+        }
+        WTExternalBuilder builder(argv[2],bytes);
+        return builder.build(argv[3]);
+    }
+    if(argc>2 && !strcmp(argv[1],"-b"))
+        return benchBuild(max(1,atoi(argv[2])),
+                          argc>3 ? atoi(argv[3]) : 10000000,
+                          argc>4 ? atoi(argv[4]) : 1000);
+    if(argc>1 && !strcmp(argv[1],"-l"))
+        return benchIndex(argc>2 ? atoi(argv[2]) : 10000000,
+                          argc>3 ? atoi(argv[3]) : 1000,
+                          argc>4 ? atoi(argv[4]) : 1000000);
+
+    int *array, size;
     int runs[]={5,2,7,2,1,1,1,2,4,5};
 
     int ro=sizeof(runs)/sizeof(int);
@@ -61,12 +257,12 @@ int main(int argc, char* argv[]){
     Theorem *th = new Theorem1(&p);
     //Theorem *th = new Theorem2(&p);
 
-	cout<<th->pi(0)<<endl;
+    cout<<th->pi(0)<<endl;
 
-	//th->save("test.x");
-	//th->load("test.x");
+    //th->save("test.x");
+    //th->load("test.x");
 
-	cout<<th->piInv(0)<<endl;
+    cout<<th->piInv(0)<<endl;
 
     return 0;
 }
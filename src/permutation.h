@@ -23,10 +23,84 @@
 #define PERMUTATION_H_INCLUDED
 
 #include<iostream>
+#include<vector>
+#include<thread>
+#include<type_traits>
+#include"buildprofile.h"
+#ifdef __AVX2__
+#include<immintrin.h>
+#endif
 
 using namespace std;
 
+//ranges of fewer elements are scanned by a single thread
+#define PERM_PAR_THRESHOLD (1<<16)
+
+/* masks of the 32 positions from a (a[-1] must be readable): bit k of down is
+ * set if a[k]<a[k-1] (a Run starts at a+k), and bit k of jump if
+ * a[k]!=a[k-1]+1 (an SRun starts at a+k) */
+template <class T>
+inline void runMasks(const T* a, unsigned int& down, unsigned int& jump){
+    down=jump=0;
+    for(int k=0; k<32; k++){
+        down |= (unsigned int)(a[k]<a[k-1])<<k;
+        jump |= (unsigned int)(a[k]!=a[k-1]+1)<<k;
+    }
+}
+
+#ifdef __AVX2__
+template <>
+inline void runMasks<int>(const int* a, unsigned int& down, unsigned int& jump){
+    const __m256i one=_mm256_set1_epi32(1);
+    down=jump=0;
+    for(int k=0; k<32; k+=8){
+        __m256i curr=_mm256_loadu_si256((const __m256i*)(a+k));
+        __m256i prev=_mm256_loadu_si256((const __m256i*)(a+k-1));
+        down |= (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(prev,curr)))<<k;
+        jump |= (unsigned int)(~_mm256_movemask_ps(_mm256_castsi256_ps(
+                    _mm256_cmpeq_epi32(curr,_mm256_add_epi32(prev,one))))&0xff)<<k;
+    }
+}
+#endif
+
+/* writes the next count values of src into buf: src is a callback
+ * src(buf,count), or a forward iterator */
+template <class T, class I, class F>
+inline auto permFill(F& src, T* buf, I count, int) -> decltype(src(buf,count), void()){
+    src(buf,count);
+}
+
+template <class T, class I, class It>
+inline void permFill(It& src, T* buf, I count, long){
+    for(I k=0; k<count; k++, ++src)
+        buf[k]=*src;
+}
+
+//values filled at a time by Permutation(n,src), and scanned while in cache
+#define PERM_CHUNK (1<<16)
+
 /** Auxiliar class to handle permutations and the identification of runs within it.
+ *
+ *  Runs and SRuns are found by scanRuns in a single pass over the array: the
+ *  steps between consecutive elements are compared 32 at a time (AVX2 for
+ *  int), and the masks are stored as a bitmap of the starts (n bits). With
+ *  runThreads>1 each thread scans a range of the array, of whole words of
+ *  the bitmap. The popcounts of the bitmap give the number of runs, and the
+ *  lengths are then written in place into an array of that size. A run
+ *  crossing the ranges of several threads is measured from the last start
+ *  found in the previous ranges.
+ *  HRuns are the Runs of the sequence of lengths of the SRuns, found by the
+ *  same scan.
+ *
+ *  Built from an iterator or a callback, the permutation owns its array:
+ *  it is filled PERM_CHUNK values at a time, and the Runs (and SRuns) of
+ *  each chunk are found while it is still in cache. The Theorems may then
+ *  sort or overwrite it (Theorem2 inPlace) without a copy by the caller.
+ *
+ *  The positions (len, the number and the lengths of the runs) are of type
+ *  T too, or its unsigned type Index, so Permutation<long long> holds more
+ *  than 2^31 elements and runs; Permutation<int> keeps 32-bit positions and
+ *  the AVX2 comparisons.
  *
  *  @author Carlos Bedregal
  */
@@ -34,39 +108,64 @@ using namespace std;
 template <class T>
 class Permutation{
     public:
+    /* type of the positions, uint for int */
+    typedef typename make_unsigned<T>::type Index;
+
     T* array;
-    unsigned int len;
-    int ro;
-    int* Runs;
-    int tau;
-    int* SRuns;
-    int Hro;
-    int* HRuns;
+    Index len;
+    Index ro; //number of Runs, SRuns and HRuns, of the type of the positions
+    T* Runs;
+    Index tau;
+    T* SRuns;
+    Index Hro;
+    T* HRuns;
+    bool ownsArray; //array was allocated by the permutation
 
     public:
-    Permutation(unsigned int n);
-    Permutation(T* A, unsigned int n);
+    Permutation(Index n);
+    Permutation(T* A, Index n);
+    /* n values read once from src, a forward iterator or a callback
+     * src(T* buf, Index count) writing the next count values, into an array
+     * owned by the permutation. The Runs (and the SRuns if sruns) are found
+     * in the same pass */
+    template <class Src>
+    Permutation(Index n, Src src, bool sruns=false);
     ~Permutation();
     T* operator[] (int pos);
     void print();
     void findRuns();
     void findSRuns();
     void findHRuns();
+    void findAllRuns();
 	void copyArray(T* perm);
+    template <class U>
+    static void scanRuns(const U* a, Index n, T** runs, Index* ro, T** sruns, Index* tau);
+    template <class U>
+    static void scanRange(const U* a, Index from, Index to, unsigned int* downs, unsigned int* jumps);
+    static unsigned int* newStarts(Index n);
+    static int scanParts(Index n);
+    static void startsToLengths(unsigned int* starts, Index n, int parts, T** lengths, Index* count);
+
+    /* threads used to find the runs (1=sequential) */
+    static int runThreads;
 };
 
 template <class T>
-Permutation<T>::Permutation(unsigned int n){
+int Permutation<T>::runThreads = 1;
+
+template <class T>
+Permutation<T>::Permutation(Index n){
     len=n;
     ro=0;
     tau=0;
     Hro=0;
+    ownsArray=false;
     //Runs=new int[n];
     //for(int i=0;i<n;Runs[i]=0,i++);
 }
 
 template <class T>
-Permutation<T>::Permutation(T* A, unsigned int n){
+Permutation<T>::Permutation(T* A, Index n){
     #ifdef PRINT
         cout<<"- Building Permutation: "<<n<<" elementos\n";
     #endif //PRINT
@@ -76,6 +175,40 @@ Permutation<T>::Permutation(T* A, unsigned int n){
     ro=0;
     tau=0;
     Hro=0;
+    ownsArray=false;
+}
+
+template <class T>
+template <class Src>
+Permutation<T>::Permutation(Index n, Src src, bool sruns){
+    #ifdef PRINT
+        cout<<"- Building Permutation: "<<n<<" elementos (filled)\n";
+    #endif //PRINT
+
+    len=n;
+    ro=0;
+    tau=0;
+    Hro=0;
+    array=new T[n];
+    ownsArray=true;
+    BuildProfile::alloc(PH_RUNS,n*sizeof(T));
+
+    //the starts of each chunk are marked while it is in cache
+    BuildTimer timer(PH_RUNS);
+    unsigned int* downs = newStarts(n);
+    unsigned int* jumps = sruns ? newStarts(n) : 0;
+    for(Index i=0; i<n; i+=PERM_CHUNK){
+        Index count = n-i<PERM_CHUNK ? n-i : PERM_CHUNK;
+        permFill(src,array+i,count,0);
+        scanRange((const T*)array,i ? i : 1,i+count,downs,jumps);
+    }
+    int parts = scanParts(n);
+    startsToLengths(downs,n,parts,&Runs,&ro);
+    delete[]downs;
+    if(sruns){
+        startsToLengths(jumps,n,parts,&SRuns,&tau);
+        delete[]jumps;
+    }
 }
 
 template <class T>
@@ -83,6 +216,7 @@ Permutation<T>::~Permutation(){
     if(ro!=0) delete[]Runs;
     if(tau!=0) delete[]SRuns;
     if(Hro!=0) delete[]HRuns;
+    if(ownsArray) delete[]array;
 }
 
 template <class T>
@@ -97,7 +231,7 @@ void Permutation<T>::copyArray(T* perm){
 
 template <class T>
 void Permutation<T>::print(){
-    int i;
+    Index i;
     cout<<"Array["<<len<<"]\n";
     for(i=0; i<len; i++)
         cout<<array[i]<<" ";
@@ -125,23 +259,7 @@ void Permutation<T>::findRuns(){
 	#ifdef PRINT
 		cout<<"\t- Identifying Runs\n";
 	#endif //PRINT
-    unsigned int i;
-    for(i=1; i<len; i++){
-        if(array[i]<array[i-1]) //run down_step
-            ro++;
-    }
-    ro++;
-
-    Runs=new int[ro];
-    for(int j=0;j<ro;Runs[j]=0,j++);
-
-    ro=0;
-    for(i=1; i<len; i++){//calculate the size of each run
-        Runs[ro]++;
-        if(array[i]<array[i-1]) //run down_step
-            ro++;
-    }
-    Runs[ro++]++; //last position
+    scanRuns(array,len,&Runs,&ro,0,0);
 }
 
 template <class T>
@@ -150,23 +268,7 @@ void Permutation<T>::findSRuns(){
 	#ifdef PRINT
 		cout<<"\t- Identifying SRuns\n";
 	#endif //PRINT
-    unsigned int i;
-    for(i=1; i<len; i++){
-        if(array[i]!=array[i-1]+1)//strict run down_step
-            tau++;
-    }
-	tau++;
-
-    SRuns=new int[tau];
-    for(int j=0;j<tau;SRuns[j]=0,j++);
-
-    tau=0;
-    for(i=1; i<len; i++){//calculate the size of each run
-        SRuns[tau]++;
-        if(array[i]!=array[i-1]+1)//strict run down_step
-            tau++;
-    }
-    SRuns[tau++]++; //last position
+    scanRuns(array,len,0,0,&SRuns,&tau);
 }
 
 template <class T>
@@ -175,22 +277,148 @@ void Permutation<T>::findHRuns(){
 	#ifdef PRINT
 		cout<<"\t- Identifying HRuns\n";
 	#endif //PRINT
-    int i;
-    for(i=1, Hro=0; i<tau; i++){
-        if(SRuns[i]<SRuns[i-1]) //SRun down_step
-            Hro++;
+    findSRuns();
+    scanRuns(SRuns,tau,&HRuns,&Hro,0,0);
+}
+
+/* Runs, SRuns and HRuns with one pass over the array */
+template <class T>
+void Permutation<T>::findAllRuns(){
+	#ifdef PRINT
+		cout<<"\t- Identifying Runs, SRuns and HRuns\n";
+	#endif //PRINT
+    if(ro==0 && tau==0) scanRuns(array,len,&Runs,&ro,&SRuns,&tau);
+    findRuns();
+    findHRuns();
+}
+
+/* ranges scanned at the same time for n elements, with runThreads */
+template <class T>
+int Permutation<T>::scanParts(Index n){
+    int parts = runThreads;
+    if(parts>1 && n/parts<PERM_PAR_THRESHOLD) parts = n/PERM_PAR_THRESHOLD>1 ? n/PERM_PAR_THRESHOLD : 1;
+    return parts;
+}
+
+/* bitmap of the starts of the runs of n elements: n/32+1 words, with the
+ * first (a run starts at 0) and the last one set, the others are written by
+ * scanRange */
+template <class T>
+unsigned int* Permutation<T>::newStarts(Index n){
+    Index words = n/32+1;
+    unsigned int* starts = new unsigned int[words];
+    BuildProfile::alloc(PH_RUNS,words*sizeof(unsigned int));
+    starts[words-1] = 0;
+    starts[0] = 1;
+    return starts;
+}
+
+/* lengths of the Runs (if runs) and SRuns (if sruns) of a[0,n), as new
+ * arrays of *ro and *tau elements. Each thread marks the starts in a range
+ * of a that covers whole words of the bitmaps, then the lengths are written
+ * from the bitmaps */
+template <class T>
+template <class U>
+void Permutation<T>::scanRuns(const U* a, Index n, T** runs, Index* ro, T** sruns, Index* tau){
+    BuildTimer timer(PH_RUNS);
+    int parts = scanParts(n);
+    unsigned int* downs = runs ? newStarts(n) : 0;
+    unsigned int* jumps = sruns ? newStarts(n) : 0;
+    //a[0] starts the first run, a range starting at from compares a[from-1]
+    vector<Index> from(parts+1);
+    for(int p=0; p<=parts; p++)
+        from[p] = (Index)((unsigned long long)n*p/parts/32*32);
+    from[0] = 1;
+    from[parts] = n>1 ? n : 1;
+    if(parts==1)
+        scanRange(a,from[0],from[1],downs,jumps);
+    else{
+        vector<thread> pool;
+        for(int p=0; p<parts; p++)
+            pool.push_back(thread(&Permutation<T>::template scanRange<U>,a,from[p],from[p+1],downs,jumps));
+        for(int p=0; p<parts; p++) pool[p].join();
     }
-    Hro++;
+    if(runs){
+        startsToLengths(downs,n,parts,runs,ro);
+        delete[]downs;
+    }
+    if(sruns){
+        startsToLengths(jumps,n,parts,sruns,tau);
+        delete[]jumps;
+    }
+}
 
-    HRuns=new int[Hro];
-    for(i=0;i<Hro;HRuns[i]=0,i++);
+/* marks in downs (if not 0) the Runs, and in jumps (if not 0) the SRuns
+ * starting in [from,to). from is 1 or a multiple of 32, and the words
+ * before the first multiple of 32 and after the last one must be cleared */
+template <class T>
+template <class U>
+void Permutation<T>::scanRange(const U* a, Index from, Index to, unsigned int* downs, unsigned int* jumps){
+    Index i=from;
+    unsigned int d, j;
+    for(; i<to && i%32; i++){
+        if(downs && a[i]<a[i-1]) downs[i/32] |= 1u<<(i%32);
+        if(jumps && a[i]!=a[i-1]+1) jumps[i/32] |= 1u<<(i%32);
+    }
+    for(; i+32<=to; i+=32){
+        runMasks(a+i,d,j);
+        if(downs) downs[i/32]=d;
+        if(jumps) jumps[i/32]=j;
+    }
+    for(; i<to; i++){
+        if(downs && a[i]<a[i-1]) downs[i/32] |= 1u<<(i%32);
+        if(jumps && a[i]!=a[i-1]+1) jumps[i/32] |= 1u<<(i%32);
+    }
+}
 
-    Hro=0;
-    for(i=1; i<tau; i++){//calculate the size of each SRun
-        HRuns[Hro]++;
-        if(SRuns[i]<SRuns[i-1]) //SRun down_step
-            Hro++;
+/* lengths of the runs starting at the bits of starts, in [0,n), as a new
+ * array of *count elements. The words are split in parts: each one counts
+ * its starts, then writes the lengths of the runs ending in it, measured
+ * from the last start of the previous parts */
+template <class T>
+void Permutation<T>::startsToLengths(unsigned int* starts, Index n, int parts, T** lengths, Index* count){
+    Index words = n/32+1;
+    vector<Index> wfrom(parts+1), offset(parts+1,0), last(parts,0), open(parts+1,0);
+    for(int p=0; p<=parts; p++)
+        wfrom[p] = (Index)((unsigned long long)words*p/parts);
+    auto countPart = [&](int p){
+        for(Index w=wfrom[p]; w<wfrom[p+1]; w++)
+            if(starts[w]){
+                offset[p+1] += __builtin_popcount(starts[w]);
+                last[p] = w*32+31-__builtin_clz(starts[w]);
+            }
+    };
+    //the starts of part p end the runs offset[p]-1..offset[p+1]-2
+    T* L = 0;
+    auto fillPart = [&](int p){
+        Index k=offset[p], prev=open[p];
+        for(Index w=wfrom[p]; w<wfrom[p+1]; w++)
+            for(unsigned int d=starts[w]; d; d&=d-1){
+                Index pos=w*32+__builtin_ctz(d);
+                if(k) L[k-1]=pos-prev;
+                prev=pos;
+                k++;
+            }
+    };
+    if(parts==1) countPart(0);
+    else{
+        vector<thread> pool;
+        for(int p=0; p<parts; p++) pool.push_back(thread(countPart,p));
+        for(int p=0; p<parts; p++) pool[p].join();
+    }
+    for(int p=0; p<parts; p++){
+        open[p+1] = offset[p+1] ? last[p] : open[p];
+        offset[p+1] += offset[p];
+    }
+    *count = offset[parts];
+    L = *lengths = new T[*count];
+    BuildProfile::alloc(PH_RUNS,*count*sizeof(T));
+    if(parts==1) fillPart(0);
+    else{
+        vector<thread> pool;
+        for(int p=0; p<parts; p++) pool.push_back(thread(fillPart,p));
+        for(int p=0; p<parts; p++) pool[p].join();
     }
-    HRuns[Hro++]++; //last position
+    L[*count-1] = n ? n-open[parts] : 1; //1 for an empty permutation, as before
 }
 #endif // PERMUTATION_H_INCLUDED
@@ -22,12 +22,36 @@
 #ifndef THEOREM_H_INCLUDED
 #define THEOREM_H_INCLUDED
 
+#include <cstring>
+
 #include "wavelettree.h"
 #include "waveletnode.h"
 
 using namespace std;
 
+/** Forward iterator over pi(i), pi(i+1), ..., pi(n-1), returned by
+ *  Theorem::iterator and deleted by the caller. I is the type of the
+ *  positions.
+ *
+ *  @author Carlos Bedregal
+ */
+template <class I>
+class PiIteratorT{
+    public:
+    virtual ~PiIteratorT(){};
+    /* true while there are positions left */
+    virtual bool hasNext() = 0;
+    /* returns pi of the current position and moves to the next one */
+    virtual I next() = 0;
+};
+
+typedef PiIteratorT<uint> PiIterator;
+
 /** Base [abstract] class for the Hu-Tucker shaped Wavelet Tree [1] implementation.
+ *
+ *  T is the type of the values of the permutation, and its unsigned type
+ *  (Index) the one of the positions: Theorem (int) keeps 32-bit positions,
+ *  TheoremT<long long> takes permutations of more than 2^31 elements.
  *
  *  [1] J. Barbay and G. Navarro, Compressed Representation of Permutations,
  *  and Applications.
@@ -35,15 +59,31 @@ using namespace std;
  *  @author Carlos Bedregal
  */
 
-class Theorem{
+template <class T>
+class TheoremT{
     public:
+    typedef typename make_unsigned<T>::type Index;
+
+    virtual ~TheoremT(){};
+    virtual Index length(){return len;}
+    virtual WaveletTree<T> * tree() = 0;
+
+    /* pi and piInv only read the structure, several threads may query it
+     * concurrently once built or loaded */
+    virtual Index pi(T i) = 0;
+    virtual Index piInv(T i) = 0;
 
-    virtual ~Theorem(){};
-    virtual uint length(){return len;}
-    virtual WaveletTree<int> * tree() = 0;
+    /* iterator over pi from position i on, cheaper per step than pi(i) */
+    virtual PiIteratorT<Index>* iterator(T i=0) = 0;
 
-    virtual uint pi(int i) = 0;
-    virtual uint piInv(int i) = 0;
+    /* writes pi(k) (piInv(k)) into out[k-i] for i<=k<=j. pi_range walks the
+     * runs of the interval with iterator() */
+    virtual void pi_range(T i, T j, T* out);
+    virtual void piInv_range(T i, T j, T* out) = 0;
+
+    /* writes pi(i) (piInv(i)) into out[i] for every i<length() */
+    virtual void decode(T* out) = 0;
+    virtual void decodeInverse(T* out) = 0;
 
     /* saves the structure into files with prefix "fname" */
     virtual int save(char* fname) = 0;
@@ -51,13 +91,24 @@ class Theorem{
     virtual int load(char* fname) = 0;
 
     /* returns the number of bytes in memory */
-    virtual int size() =0;
+    virtual size_t size() =0;
     /* returns the number of bits required by the bitsequences*/
-    virtual unsigned int bitsRequired() =0;
+    virtual size_t bitsRequired() =0;
 
     protected:
 	/* size of permutation (aka size of tree's root) */
-    uint len;
+    Index len;
 };
 
+typedef TheoremT<int> Theorem;
+
+template <class T>
+void TheoremT<T>::pi_range(T i, T j, T* out){
+    if(i>j) return;
+    PiIteratorT<Index>* it = iterator(i);
+    for(T k=i; k<=j; k++)
+        out[k-i] = it->next();
+    delete it;
+}
+
 #endif // THEOREM_H_INCLUDED
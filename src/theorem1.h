@@ -22,11 +22,15 @@
 #ifndef THEOREM1_H_INCLUDED
 #define THEOREM1_H_INCLUDED
 
+#include<vector>
+#include<algorithm>
 #include"theorem.h"
+#include"wtquery.h"
 
 /** Implementation of Compressed Data Structure for Permutations based on 
  *	Wavelet Tree (Hu-Tucker) using ascending sub-sequences (Runs).
  *  (Theorem2 or TH2 for practical use)
+ *  T is the type of the values, see TheoremT; Theorem1 is Theorem1T<int>.
  *
  *  [1] J. Barbay and G. Navarro, Compressed Representation of Permutations,
  *  and Applications.
@@ -34,41 +38,72 @@
  *  @author Carlos Bedregal
  */
 
-class Theorem1:public Theorem{
+template <class T>
+class Theorem1T:public TheoremT<T>{
     public:
-    WaveletTree<int> *wt;
+    typedef typename make_unsigned<T>::type Index;
+    typedef typename WaveletTree<T>::Node Node;
+    typedef typename WTSparse<Index>::type Sparse;
+
+    WaveletTree<T> *wt;
     //int waste;
+    /* bitseqFlag used by the nodes, selects the WTQuery specialization */
+    int bitseqType;
+    /* optional leaf index, see buildLeafIndex: ones at the run starts, and
+     * the parent and side (bit) of the leaf of each run */
+    Sparse* runStarts;
+    Node** leafParent;
+    uint* leafSide;
 
     public:
-    Theorem1();
-    Theorem1(Permutation<int> *p);
-    virtual ~Theorem1();
+    Theorem1T();
+    Theorem1T(Permutation<T> *p);
+    virtual ~Theorem1T();
+
+    WaveletTree<T> * tree();
+
+    Index pi(T i);
+    template <class BS> Index piBS(T i);
+    Index piInv(T i);
 
-    WaveletTree<int> * tree();
+    void buildLeafIndex();
+    void recLeafIndex(Node* node, uint* starts, Index& r, Index& pos);
+    void clearLeafIndex();
 
-    uint pi(int i);
-    uint recPi(WTNode* node, WTNode* parent, int j);
-    uint piInv(int i);
-    uint recPiInv(WTNode* node, int i);
+    PiIteratorT<Index>* iterator(T i=0);
+    void piInv_range(T i, T j, T* out);
+
+    void decode(T* out);
+    void recDecode(Node* node, T* src, T* dst, T* out, Index off);
+    void decodeInverse(T* out);
+    void recDecodeInverse(Node* node, T* src, T* dst, Index off);
 
     int save (char* fname);
-    int recSave(WTNode* node, FILE* fp, uint* shape, uint& curr);
+    int recSave(Node* node, FILE* fp, uint* shape, Index& curr);
 
     int load (char* fname);
     int loadWT(FILE* fp,FILE* fh);
-    int recLoad(FILE* fp, WTNode* node, uint* shape, uint& curr);
+    int recLoad(FILE* fp, Node* node, uint* shape, Index& curr);
+
+    size_t size();
+    void recSize(Node* node, size_t& size);
 
-    int size();
-    void recSize(WTNode* node, int& size);
+    size_t bitsRequired();
 
-    unsigned int bitsRequired();
+    static Theorem1T* compose(TheoremT<T>* a, TheoremT<T>* b);
 };
 
-Theorem1::Theorem1(){
+typedef Theorem1T<int> Theorem1;
+
+template <class T>
+Theorem1T<T>::Theorem1T(){
     wt=0;
+    bitseqType=bitseqFlag;
+    runStarts=0; leafParent=0; leafSide=0;
 }
 
-Theorem1::Theorem1(Permutation<int> *p){
+template <class T>
+Theorem1T<T>::Theorem1T(Permutation<T> *p){
     assert(p!=0);
     assert(p->len>0);
     #ifdef PRINT
@@ -76,104 +111,190 @@ Theorem1::Theorem1(Permutation<int> *p){
     #endif //PRINT
     //Permutation<int>* p = new Permutation<int>(array,n);
 
-    len=p->len;
-    wt=new WaveletTree<int>(p->array,p->Runs,p->ro);
-    cout<<"nodes: "<<wt->weight<<endl;
+    this->len=p->len;
+    bitseqType=bitseqFlag;
+    runStarts=0; leafParent=0; leafSide=0;
+    wt=new WaveletTree<T>(p->array,p->Runs,p->ro);
+    #ifdef PRINT
+        cout<<"nodes: "<<wt->weight<<endl;
+    #endif //PRINT
 }
 
-Theorem1::~Theorem1(){
+template <class T>
+Theorem1T<T>::~Theorem1T(){
+    clearLeafIndex();
     delete wt;
 }
 
-WaveletTree<int>* Theorem1::tree(){
+template <class T>
+WaveletTree<T>* Theorem1T<T>::tree(){
     return wt;
 }
 
-uint Theorem1::pi(int i){
-    return recPi(wt->root,0,i+1);
+/* pi and piInv run the traversal specialized for the bitsequence type of the
+ * nodes, see WTDispatch in wtquery.h */
+template <class T>
+typename Theorem1T<T>::Index Theorem1T<T>::pi(T i){
+    return WTDispatch<Index>::run(bitseqType,[&](auto bs){
+        return piBS<typename remove_pointer<decltype(bs)>::type>(i);
+    });
 }
 
-uint Theorem1::recPi(WTNode* node, WTNode* parent, int j){
-    static int s;
-
-    //s=node->size;
-    s=node->bitseq->length();
+/* with the leaf index the run r of i and its offset come from runStarts, and
+ * only the upward half of the traversal is done */
+template <class T>
+template <class BS>
+typename Theorem1T<T>::Index Theorem1T<T>::piBS(T i){
+    if(!runStarts)
+        return WTQuery<BS>::pi(wt->root,i);
+    Index r = runStarts->rank1(i);
+    Index j = i - runStarts->select1(r) + 1;
+    r--;
+    return WTQuery<BS>::piLeaf(leafParent[r],bitget(leafSide,r),j);
+}
 
-    #ifdef DEBUG
-        cout<<"\tDOWN: nodo: "<<node->size<<", s: "<<s<<", j: "<<j<<", rank0(B,s-1): "<<node->bitseq->rank0(s-1)<<endl;
-    #endif //DEBUG
+/* builds the leaf index used by pi: an Elias-Fano bitmap of the run starts
+ * (ro*(2+log(n/ro)) bits, n bits with 64-bit positions, see WTSparse), and
+ * for each run the parent of its leaf and the
+ * side it hangs on. The parent pointers of the nodes are set too. It is not
+ * saved, call it again after load */
+template <class T>
+void Theorem1T<T>::buildLeafIndex(){
+    clearLeafIndex();
+    Index ro = wt->weight+1;
+    Index words = (this->len+W-1)/W;
+    uint* starts = new uint[words];
+    for(Index k=0; k<words; k++) starts[k]=0;
+    leafParent = new Node*[ro];
+    leafSide = new uint[(ro+W-1)/W];
+    for(Index k=0; k<(ro+W-1)/W; k++) leafSide[k]=0;
+    Index r=0;
+    Index pos=0;
+    wt->root->parent=0;
+    recLeafIndex(wt->root,starts,r,pos);
+    assert(r==ro && pos==this->len);
+    runStarts = new Sparse(starts,this->len);
+    delete[]starts;
+}
 
-    //downward traversal to determine leaf v and offset j
-    //a) go down to the left
-    if(node->bitseq->rank0(s-1) >= (unsigned int)j){
-        if(!node->children[0])
-            j=node->bitseq->select0(j)+1;
-        else
-            j=recPi(node->children[0],node,j);
-    }
-    //b) go down to the right
-    else{
-        j=j-node->bitseq->rank0(s-1);
-        if(!node->children[1])
-            j=node->bitseq->select1(j)+1;
-        else
-            j=recPi(node->children[1],node,j);
+/* leaves are the null children, visited left to right they are the runs in
+ * order, the left one of node covering its first node->zeros positions */
+template <class T>
+void Theorem1T<T>::recLeafIndex(Node* node, uint* starts, Index& r, Index& pos){
+    Index sizes[2] = {node->zeros, node->bitseq->length()-node->zeros};
+    for(uint c=0; c<2; c++){
+        Node* child=node->children[c];
+        if(child){
+            child->parent=node;
+            recLeafIndex(child,starts,r,pos);
+        }
+        else{
+            bitset(starts,pos);
+            leafParent[r]=node;
+            if(c) bitset(leafSide,r);
+            r++;
+            pos+=sizes[c];
+        }
     }
+}
 
-    #ifdef DEBUG
-        cout<<"\tUP: nodo: "<<node->size<<", s: "<<s<<", j: "<<j;
-    #endif //DEBUG
-
-    //we've reach the root
-    if(!parent)
-        return j-1;
-
-    #ifdef DEBUG
-        cout<<", left_child?: "<<(node==parent->children[0])<<endl;
-    #endif //DEBUG
+template <class T>
+void Theorem1T<T>::clearLeafIndex(){
+    delete runStarts;
+    delete[]leafParent;
+    delete[]leafSide;
+    runStarts=0; leafParent=0; leafSide=0;
+}
 
-    //upward traversal of nodes in the recursion stack
-    //a) left child of parent
-    if(node==parent->children[0])
-        j=parent->bitseq->select0(j);
-    //b) right child of parent
-    else
-        j=parent->bitseq->select1(j);
+template <class T>
+typename Theorem1T<T>::Index Theorem1T<T>::piInv(T i){
+    return WTDispatch<Index>::run(bitseqType,[&](auto bs){
+        return WTQuery<typename remove_pointer<decltype(bs)>::type>::piInv(wt->root,i);
+    });
+}
 
-    return ++j;
+template <class T>
+PiIteratorT<typename Theorem1T<T>::Index>* Theorem1T<T>::iterator(T i){
+    return WTDispatch<Index>::run(bitseqType,[&](auto bs) -> PiIteratorT<Index>* {
+        return new WTIterator<typename remove_pointer<decltype(bs)>::type>(wt->root,this->len,i);
+    });
 }
 
-uint Theorem1::piInv(int i){
-    return recPiInv(wt->root,i);
+template <class T>
+void Theorem1T<T>::piInv_range(T i, T j, T* out){
+    WTDispatch<Index>::run(bitseqType,[&](auto bs){
+        WTQuery<typename remove_pointer<decltype(bs)>::type>::piInvRange(wt->root,i,j,out);
+    });
 }
 
-uint Theorem1::recPiInv(WTNode* node, int i){
-    static int p=0;
-    static int s;
+/* writes pi(i) into out[i] for all i. Going down from the root, the values
+ * of each node (in increasing order) are split stably by its bitmap between
+ * its children, so a leaf receives the values of its run in order, which are
+ * the values of its positions. O(n*depth), sequential over src/dst/out */
+template <class T>
+void Theorem1T<T>::decode(T* out){
+    T* tmp = new T[this->len];
+    for(Index i=0; i<this->len; i++) out[i]=i;
+    recDecode(wt->root,out,tmp,out,0);
+    delete[]tmp;
+}
 
-    //is leaf?
-    if(!node){
-        int result=p+i;
-        p=0;
-        return result;
+/* values of node are in src[off..off+length), they are split into dst and
+ * the children continue with the roles of src and dst swapped */
+template <class T>
+void Theorem1T<T>::recDecode(Node* node, T* src, T* dst, T* out, Index off){
+    Index n=node->bitseq->length();
+    uint* bitmap = new uint[(n+W-1)/W];
+    node->bitseq->get_bitmap(bitmap);
+    T* child[2] = {dst+off, dst+off+node->zeros};
+    for(Index k=0; k<n; k++)
+        *child[bitget(bitmap,k)!=0]++ = src[off+k];
+    delete[]bitmap;
+
+    Index offs[2] = {off, off+node->zeros};
+    Index sizes[2] = {node->zeros, n-node->zeros};
+    for(int c=0; c<2; c++){
+        if(node->children[c])
+            recDecode(node->children[c],dst,src,out,offs[c]);
+        else if(dst!=out) //leaf: the values of the run are final
+            for(Index k=0; k<sizes[c]; k++) out[offs[c]+k]=dst[offs[c]+k];
     }
+}
 
-    //s=node->size;
-    s=node->bitseq->length();
-
-    #ifdef DEBUG
-        cout<<"\tnodo: "<<node->size<<", s: "<<s<<", i: "<<i<<", p: "<<p<<", B[i]: "<<node->bitseq->access(i)<<endl;
-    #endif //DEBUG
+/* writes piInv(i) into out[i] for all i. Redoes the merges of
+ * WaveletTree::recBuild bottom-up over positions instead of values: a leaf
+ * holds the positions of its run (increasing) and each node merges the
+ * lists of its children by its bitmap. O(n*depth), sequential */
+template <class T>
+void Theorem1T<T>::decodeInverse(T* out){
+    T* tmp = new T[this->len];
+    recDecodeInverse(wt->root,tmp,out,0);
+    delete[]tmp;
+}
 
-    //B[i]=1, go down to the right
-    if(node->bitseq->access(i)){
-        p=p+node->bitseq->rank0(s-1);
-        return recPiInv(node->children[1],node->bitseq->rank1(i)-1);
+/* leaves in dst[off..off+length) the positions of node sorted by value, the
+ * children leave theirs in src */
+template <class T>
+void Theorem1T<T>::recDecodeInverse(Node* node, T* src, T* dst, Index off){
+    Index n=node->bitseq->length();
+    Index offs[2] = {off, off+node->zeros};
+    T* child[2];
+    for(int c=0; c<2; c++){
+        if(node->children[c]){
+            recDecodeInverse(node->children[c],dst,src,offs[c]);
+            child[c]=src+offs[c];
+        }
+        else
+            child[c]=0; //leaf: consecutive positions from offs[c]
     }
-    //B[i]=0, go down to the left
-    else{
-        return recPiInv(node->children[0],node->bitseq->rank0(i)-1);
+
+    uint* bitmap = new uint[(n+W-1)/W];
+    node->bitseq->get_bitmap(bitmap);
+    for(Index k=0; k<n; k++){
+        int c = bitget(bitmap,k)!=0;
+        dst[off+k] = child[c] ? *child[c]++ : offs[c]++;
     }
+    delete[]bitmap;
 }
 
 /* saves structure TH1's bitmaps into files with prefix "fname" through recursive
@@ -181,12 +302,15 @@ uint Theorem1::recPiInv(WTNode* node, int i){
  * - fname: stores th1's bitsequences
  * - fname.idx: stores the tree shape
  */
-int Theorem1::save (char* fname){
+template <class T>
+int Theorem1T<T>::save (char* fname){
 	char fname2[128];
 	strcpy(fname2,fname);
 	strcat(fname2,".idx");
-	uint* shape = new uint[uint_len(wt->weight*2,1)+1];
-	uint curr=0;
+	Index words = (2*wt->weight+W-1)/W+1;
+	uint* shape = new uint[words];
+	for(Index k=0; k<words; k++) shape[k]=0;
+	Index curr=0;
 
     FILE * output;
     output = fopen(fname,"wb");
@@ -199,29 +323,28 @@ int Theorem1::save (char* fname){
 	hierarchy = fopen(fname2,"wb");
 
 	//save tree structure
-	fwrite(&curr,sizeof(uint),1,hierarchy);
-	fwrite(shape,sizeof(uint),uint_len(wt->weight*2,1)+1,hierarchy);
+	fwrite(&curr,sizeof(Index),1,hierarchy);
+	fwrite(shape,sizeof(uint),words,hierarchy);
 	fclose(hierarchy);
 
 	delete[]shape;
     return ret;
 }
 
-int Theorem1::recSave(WTNode* node, FILE* fp, uint* shape, uint& curr){
-    //static char child;
-	static bool exit;
+template <class T>
+int Theorem1T<T>::recSave(Node* node, FILE* fp, uint* shape, Index& curr){
     if(!node){
         //child='0';
         //fwrite(&child,sizeof(char),1,fp);
-		bitclean(shape,curr++);
+		bitclean(shape,curr); curr++;
         return 0;
     }
     else{
         //child='1';
         //fwrite(&child,sizeof(char),1,fp);
-		bitset(shape,curr++);
+		bitset(shape,curr); curr++;
 		//save node's bitsequence+headers into fp
-		exit = node->save(fp);
+		int exit = node->save(fp);
         assert(exit==0);
         return recSave(node->children[0],fp,shape,curr) + recSave(node->children[1],fp,shape,curr);
     }
@@ -232,7 +355,8 @@ int Theorem1::recSave(WTNode* node, FILE* fp, uint* shape, uint& curr){
  * - fname contains the bitsequence of each node
  * - fname.idx: contains the three shape
  */
-int Theorem1::load(char* fname){
+template <class T>
+int Theorem1T<T>::load(char* fname){
 	char fname2[128];
 	strcpy(fname2,fname);
 	strcat(fname2,".idx");
@@ -260,44 +384,48 @@ int Theorem1::load(char* fname){
  * - fp contains the bitsequence of each node
  * - fh contains the three shape
  */
-int Theorem1::loadWT(FILE* fp, FILE* fh){
+template <class T>
+int Theorem1T<T>::loadWT(FILE* fp, FILE* fh){
+	clearLeafIndex();
 	//load tree structure fro fh
-	uint curr=0;
-	if(fread(&curr,sizeof(uint),1,fh)!=1 || curr==0){
+	Index curr=0;
+	if(fread(&curr,sizeof(Index),1,fh)!=1 || curr==0){
 		cout<<"@Theorem1::loadWT(): fread(tree.size)\n";
 		return -1;
 	}
 
-	uint* shape = new uint[uint_len(curr,1)];
-	if (fread (shape,sizeof(uint),uint_len(curr,1),fh) != uint_len(curr,1)){
+	Index words = (curr+W-1)/W;
+	uint* shape = new uint[words];
+	if (fread (shape,sizeof(uint),words,fh) != words){
 		cout<<"@Theorem1::loadWT(): fread(tree.shape)\n";
 		return -1;
 	}
 
 	//load root of wavelet tree
 	curr=0;
-	wt = new WaveletTree<int>();
-    wt->root = new WTNode(); wt->weight++;
-    if(bitget(shape,curr++)!=1){
+	wt = new WaveletTree<T>();
+    wt->root = new Node(); wt->weight++;
+    if(bitget(shape,curr)!=1){
 		cout<<"@Theorem1::loadWT(): root flag\n";
 		return -1;
 	}
+	curr++;
     if(wt->root->load(fp)!=0){
 		cout<<"@Theorem1::loadWT() root->load\n";
 		return -1;
 	}
-	len = wt->root->bitseq->length();
+	this->len = wt->root->bitseq->length();
 
 	//load wavelet tree recursively
     return recLoad(fp,wt->root,shape,curr);
 }
 
-int Theorem1::recLoad(FILE* fp, WTNode* node, uint* shape, uint& curr){
-    static bool child;
+template <class T>
+int Theorem1T<T>::recLoad(FILE* fp, Node* node, uint* shape, Index& curr){
     //left child
-	child = bitget(shape,curr++);
+	bool child = bitget(shape,curr); curr++;
     if(child){ //next to read is child of node
-        node->children[0] = new WTNode(); wt->weight++;
+        node->children[0] = new Node(); wt->weight++;
         if(node->children[0]->load(fp)!=0){
 			cout<<"@Theorem1::recLoad() left_child->load\n";
 			return -1;
@@ -308,9 +436,9 @@ int Theorem1::recLoad(FILE* fp, WTNode* node, uint* shape, uint& curr){
 		node->children[0] = 0;
     }
     //right child
-    child = bitget(shape,curr++);
+    child = bitget(shape,curr); curr++;
     if(child){ //next to read is child of node
-        node->children[1] = new WTNode(); wt->weight++;
+        node->children[1] = new Node(); wt->weight++;
         if(node->children[1]->load(fp)!=0){
 			cout<<"@Theorem1::recLoad() right_child->load\n";
 			return -1;
@@ -324,26 +452,93 @@ int Theorem1::recLoad(FILE* fp, WTNode* node, uint* shape, uint& curr){
     return 0;
 }
 
-int Theorem1::size (){
-    int size = 0;
+template <class T>
+size_t Theorem1T<T>::size (){
+    size_t size = 0;
     //waste = 0;
     recSize(wt->root,size);
-    return sizeof(Theorem1) + sizeof(WaveletTree<int>) + size;
+    if(runStarts){
+        Index ro = wt->weight+1;
+        size += runStarts->size() + ro*sizeof(Node*) + (ro+W-1)/W*sizeof(uint);
+    }
+    return sizeof(Theorem1T) + sizeof(WaveletTree<T>) + size;
 }
 
-void Theorem1::recSize(WTNode* node, int& size){
+template <class T>
+void Theorem1T<T>::recSize(Node* node, size_t& size){
     size += node->size();
     //waste += uint_len(node->bitseq->length(),1)*32-node->bitseq->length();
     if(node->children[0]) recSize(node->children[0],size);
     if(node->children[1]) recSize(node->children[1],size);
 }
 
-unsigned int Theorem1::bitsRequired(){
-    unsigned int b=0;
+template <class T>
+size_t Theorem1T<T>::bitsRequired(){
+    size_t b=0;
     wt->recBitsRequired(wt->root,b);
 	//cout<<"#B: "<<b<<endl;
 	assert(b>0);
     return b;
 }
 
+/* builds the composition c(i)=b->pi(a->pi(i)) without decompressing a or b:
+ * a is read with its iterator, and b with an iterator kept while the values
+ * of a are consecutive, so an SRun of a costs one step of b per element.
+ * c is written into the only buffer, which the construction of the tree then
+ * reuses, and the starts of its runs into a bitmap of n bits. A composition
+ * of a single run is the identity, which has no tree: it returns 0, as for
+ * permutations of different lengths */
+template <class T>
+Theorem1T<T>* Theorem1T<T>::compose(TheoremT<T>* a, TheoremT<T>* b){
+    Index n=a->length();
+    if(n!=b->length()){
+        cout<<"@Theorem1::compose(): lengths differ\n";
+        return 0;
+    }
+    T* array = new T[n];
+    Index words = (n+W-1)/W, ro = 0, i;
+    uint* starts = new uint[words];
+    for(i=0; i<words; starts[i++]=0);
+    PiIteratorT<Index>* ita = a->iterator(0);
+    PiIteratorT<Index>* itb = 0;
+    Index expected = 0; //value of a that continues itb
+    for(i=0; i<n; i++){
+        Index v = ita->next();
+        if(!itb || v!=expected){
+            delete itb;
+            itb = b->iterator(v);
+        }
+        expected = v+1;
+        array[i] = itb->next();
+        if(!i || array[i]<array[i-1]) bitset(starts,i);
+    }
+    delete ita;
+    delete itb;
+    for(i=0; i<words; i++)
+        ro += popcount(starts[i]);
+    if(ro<2){
+        cout<<"@Theorem1::compose(): the composition is the identity\n";
+        delete[]starts;
+        delete[]array;
+        return 0;
+    }
+
+    //lengths of the runs, from the distances between their starts
+    Permutation<T> p(array,n);
+    p.ro = ro;
+    p.Runs = new T[ro];
+    Index r = 0, last = 0;
+    for(i=0; i<words; i++)
+        for(uint d=starts[i]; d; d&=d-1){
+            Index pos = i*W+__builtin_ctz(d);
+            if(pos) p.Runs[r++] = pos-last;
+            last = pos;
+        }
+    p.Runs[r] = n-last;
+    delete[]starts;
+    Theorem1T* c = new Theorem1T(&p);
+    delete[]array;
+    return c;
+}
+
 #endif // THEOREM1_H_INCLUDED
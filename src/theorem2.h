@@ -28,6 +28,7 @@
 /** Implementation of Compressed Data Structure for Permutations based on 
  *	Wavelet Tree (Hu-Tucker) using strict ascending sub-sequences (SRuns).
  *  (Theorem2 or TH2 for practical use)
+ *  T is the type of the values, see TheoremT; Theorem2 is Theorem2T<int>.
  *
  *  [1] J. Barbay and G. Navarro, Compressed Representation of Permutations,
  *  and Applications.
@@ -35,36 +36,115 @@
  *  @author Carlos Bedregal
  */
 
-class Theorem2:public Theorem{
+template <class T> class Theorem2T;
+
+/** Sequential pi over a Theorem2: inside an SRun each step is an increment,
+ *  and the next SRun takes the next value of an iterator over th1.
+ *
+ *  @author Carlos Bedregal
+ */
+template <class T>
+class Theorem2Iterator : public PiIteratorT<typename make_unsigned<T>::type>{
+    typedef typename make_unsigned<T>::type Index;
+
+    Theorem2T<T>* th;
+    PiIteratorT<Index>* it1; //iterator over th1, from the current SRun on
+    Index i; //current position
+    Index end; //first position after the current SRun
+    Index k; //current SRun
+    Index val; //pi(i)
+
+    public:
+    Theorem2Iterator(Theorem2T<T>* th, T i);
+    ~Theorem2Iterator(){ delete it1; }
+    bool hasNext();
+    Index next();
+
+    private:
+    void startSRun();
+};
+
+template <class T>
+class Theorem2T:public TheoremT<T>{
     public:
-    Theorem1 *th1;
-    static_bitsequence* bitseqR;
-    static_bitsequence* bitseqRinv;
+    typedef typename make_unsigned<T>::type Index;
+    typedef typename WaveletTree<T>::Node Node;
+    typedef typename Node::Bitseq Bitseq;
+
+    Theorem1T<T> *th1;
+    Bitseq* bitseqR;
+    Bitseq* bitseqRinv;
 
     public:
-    Theorem2();
-    Theorem2(Permutation<int> *p);
-    virtual ~Theorem2();
+    Theorem2T();
+    /* inPlace: the construction reuses p->array (overwritten) for the
+     * permutation of the SRuns, so it only adds O(n) bits to the input */
+    Theorem2T(Permutation<T> *p, bool inPlace=false);
+    virtual ~Theorem2T();
 
-    WaveletTree<int> * tree();
+    WaveletTree<T> * tree();
 
-    uint pi(int i);
-    uint piInv(int i);
+    Index pi(T i);
+    Index piInv(T i);
+
+    PiIteratorT<Index>* iterator(T i=0);
+    void piInv_range(T i, T j, T* out);
+
+    void decode(T* out);
+    void decodeInverse(T* out);
+    void decodeSRuns(Bitseq* from, Bitseq* to, T* d, T* out);
 
     int save (char* fname);
     int load (char* fname);
 
-    int size();
-    unsigned int bitsRequired();
+    size_t size();
+    size_t bitsRequired();
+
+    /* creates the bitsequence for R or Rinv, with m ones out of n bits:
+     * Elias-Fano when it is smaller than a plain bitmap (few SRuns) */
+    static Bitseq* bitseqSparseCreator(uint* bitmap, Index n, Index m);
+    /* loads the Elias-Fano R or Rinv of save */
+    static Bitseq* bitseqSparseLoader(FILE* fp);
 };
 
-Theorem2::Theorem2(){
+typedef Theorem2T<int> Theorem2;
+
+template <class T>
+typename Theorem2T<T>::Bitseq* Theorem2T<T>::bitseqSparseCreator(uint* bitmap, Index n, Index m){
+    if((unsigned long long)m*(2+bits(n/max(m,(Index)1))) < n){
+        BuildTimer timer(PH_BITSEQ,false);
+        Bitseq* bs = new static_bitsequence_eliasfano(bitmap,n);
+        BuildProfile::alloc(PH_BITSEQ,bs->size());
+        return bs;
+    }
+    return Node::bitseqCreator(bitmap,n);
+}
+
+template <class T>
+typename Theorem2T<T>::Bitseq* Theorem2T<T>::bitseqSparseLoader(FILE* fp){
+    return static_bitsequence_eliasfano::load(fp);
+}
+
+/* Elias-Fano is 32-bit, R and Rinv of 64-bit positions are plain */
+template <>
+inline Theorem2T<long long>::Bitseq* Theorem2T<long long>::bitseqSparseCreator(uint* bitmap, Index n, Index m){
+    return Node::bitseqCreator(bitmap,n);
+}
+
+template <>
+inline Theorem2T<long long>::Bitseq* Theorem2T<long long>::bitseqSparseLoader(FILE* fp){
+    return 0;
+}
+
+template <class T>
+Theorem2T<T>::Theorem2T(){
     th1=0;
     bitseqR=0;
     bitseqRinv=0;
 }
 
-Theorem2::Theorem2(Permutation<int> *p){
+template <class T>
+Theorem2T<T>::Theorem2T(Permutation<T> *p, bool inPlace){
     assert(p!=0);
     assert(p->len>0);
 
@@ -73,80 +153,88 @@ Theorem2::Theorem2(Permutation<int> *p){
     #endif //PRINT
 
     //Permutation<int> *p=new Permutation<int>(array,n);
-    len=p->len;
+    this->len=p->len;
 
-    int i, pos=0, szBMap, len_;
-    unsigned int ii;
-    uint* R;
-    uint* Rinv;
+    T* array=p->array;
+    Index szBMap, len_=0, i;
+    uint *R, *Rinv, d;
 
-    //Set bitmap R
+    //Set bitmap R: bit i when an SRun starts at i, 32 positions at a time
     #ifdef PRINT
         cout<<"\t- Th2: building bitmap R\n";
     #endif //PRINT
-	p->findSRuns();
-	szBMap = uint_len(len,1);
+    BuildTimer timerR(PH_TH2_R);
+    szBMap = (this->len+W-1)/W;
     R=new uint[szBMap];
+    BuildProfile::alloc(PH_TH2_R,szBMap*sizeof(uint));
     for(i=0; i<szBMap; R[i++]=0);
-    bitset(R,pos);
-    for(i=0; i<p->tau-1; i++){
-        pos=pos+p->SRuns[i];
-        bitset(R,pos);
-    }
-	delete[]p->SRuns;
-	len_ = p->tau;
-	p->tau = 0;
-
-    //Create inverse permutation of array
-    int *arrayInv=new int[len];
-    for(ii=0;ii<len;ii++)
-        arrayInv[p->array[ii]]=ii;
-
-    //Set bitmap Rinv
+    for(i=0; i<this->len && i<W; i++)
+        if(i==0 || array[i]!=array[i-1]+1) bitset(R,i);
+    for(; i+W<=this->len; i+=W)
+        runMasks(array+i,d,R[i/W]);
+    for(; i<this->len; i++)
+        if(array[i]!=array[i-1]+1) bitset(R,i);
+    for(i=0; i<szBMap; i++)
+        len_+=popcount(R[i]);
+    timerR.stop();
+
+    //values at the SRun heads, in order; inPlace writes them over the first
+    //positions of array, which are not read again
+    BuildTimer timerRinv(PH_TH2_RINV);
+    T *array_ = inPlace ? array : new T[len_];
+    if(!inPlace) BuildProfile::alloc(PH_TH2_RINV,len_*sizeof(T));
+    Index k=0;
+    for(i=0; i<szBMap; i++)
+        for(d=R[i]; d; d&=d-1)
+            array_[k++]=array[i*W+__builtin_ctz(d)];
+
+    //Set bitmap Rinv: the values of the heads, without the inverse permutation
     #ifdef PRINT
         cout<<"\t- Th2: building bitmap Rinv\n";
     #endif //PRINT
     Rinv=new uint[szBMap];
+    BuildProfile::alloc(PH_TH2_RINV,szBMap*sizeof(uint));
     for(i=0; i<szBMap; Rinv[i++]=0);
-    for(ii=0; ii<len; ii++)
-        if(bitget(R,arrayInv[ii]))
-            bitset(Rinv,ii);
+    for(k=0; k<len_; k++)
+        bitset(Rinv,array_[k]);
+    timerRinv.stop();
 
-    delete[]arrayInv;
-
-    bitseqR = WTNode::bitseqCreator(R,len);
+    bitseqR = bitseqSparseCreator(R,this->len,len_);
     delete[]R;
-    bitseqRinv = WTNode::bitseqCreator(Rinv,len);
+    bitseqRinv = bitseqSparseCreator(Rinv,this->len,len_);
     delete[]Rinv;
 
-    //create permutation' of size [tau]
-    int *array_ = new int[len_];
-    for(i=0; i<len_; i++){
-        array_[i]=bitseqRinv->rank1(p->array[bitseqR->select1(i+1)])-1;
-    }
+    //create permutation' of size [tau]: ranks of the head values
+    BuildTimer timerSRuns(PH_TH2_SRUNS);
+    for(k=0; k<len_; k++)
+        array_[k]=bitseqRinv->rank1(array_[k])-1;
+    timerSRuns.stop();
 
 	p=0;
 
-    Permutation<int> *p_=new Permutation<int>(array_,len_);
+    Permutation<T> *p_=new Permutation<T>(array_,len_);
 	p_->findRuns();
-    th1 = new Theorem1(p_);
+    th1 = new Theorem1T<T>(p_);
 
-    delete[]array_;
+    if(!inPlace) delete[]array_;
     delete p_;
 }
 
-Theorem2::~Theorem2(){
+template <class T>
+Theorem2T<T>::~Theorem2T(){
     delete bitseqR;
     delete bitseqRinv;
     if(th1!=0) delete th1;
 }
 
-WaveletTree<int>* Theorem2::tree(){
+template <class T>
+WaveletTree<T>* Theorem2T<T>::tree(){
     return th1->wt;
 }
 
-uint Theorem2::pi(int i){
-    int i_, j_;
+template <class T>
+typename Theorem2T<T>::Index Theorem2T<T>::pi(T i){
+    T i_, j_;
     i_ = bitseqR->rank1(i)-1;
     j_ = th1->pi(i_);
 
@@ -156,8 +244,9 @@ uint Theorem2::pi(int i){
     return j_ + i - i_;
 }
 
-uint Theorem2::piInv(int i){
-    int i_, j_;
+template <class T>
+typename Theorem2T<T>::Index Theorem2T<T>::piInv(T i){
+    T i_, j_;
     i_ = bitseqRinv->rank1(i)-1;
     j_ = th1->piInv(i_);
 
@@ -167,17 +256,125 @@ uint Theorem2::piInv(int i){
     return j_ + i - i_;
 }
 
+template <class T>
+PiIteratorT<typename Theorem2T<T>::Index>* Theorem2T<T>::iterator(T i){
+    return new Theorem2Iterator<T>(this,i);
+}
+
+template <class T>
+Theorem2Iterator<T>::Theorem2Iterator(Theorem2T<T>* th, T i){
+    this->th=th;
+    this->i=i;
+    it1=0;
+    if(this->i>=th->length()) return;
+    k=th->bitseqR->rank1(i)-1;
+    it1=th->th1->iterator(k);
+    startSRun();
+    val+=i-th->bitseqR->select1(k+1);
+}
+
+template <class T>
+bool Theorem2Iterator<T>::hasNext(){
+    return i<th->length();
+}
+
+/* end and value of the first position of SRun k */
+template <class T>
+void Theorem2Iterator<T>::startSRun(){
+    end = k+1<th->th1->length() ? th->bitseqR->select1(k+2) : th->length();
+    val = th->bitseqRinv->select1(it1->next()+1);
+}
+
+template <class T>
+typename Theorem2Iterator<T>::Index Theorem2Iterator<T>::next(){
+    Index ret=val++;
+    if(++i==end && i<th->length()){
+        k++;
+        startSRun();
+    }
+    return ret;
+}
+
+/* the values i..j cover consecutive SRuns in the order of Rinv, whose
+ * targets come from one range query on th1 */
+template <class T>
+void Theorem2T<T>::piInv_range(T i, T j, T* out){
+    if(i>j) return;
+    Index k1 = bitseqRinv->rank1(i)-1, k2 = bitseqRinv->rank1(j)-1;
+    T* d = new T[k2-k1+1];
+    th1->piInv_range(k1,k2,d);
+    Index start = bitseqRinv->select1(k1+1);
+    for(Index k=k1; k<=k2; k++){
+        Index end = k+1<th1->length() ? bitseqRinv->select1(k+2) : this->len;
+        Index target = bitseqR->select1(d[k-k1]+1);
+        for(Index v=max(start,(Index)i); v<end && v<=(Index)j; v++)
+            out[v-i] = target+v-start;
+        start = end;
+    }
+    delete[]d;
+}
+
+/* writes pi(i) into out[i] for all i: th1 is decoded into the order of the
+ * SRuns, then each SRun is expanded */
+template <class T>
+void Theorem2T<T>::decode(T* out){
+    T* d = new T[th1->length()];
+    th1->decode(d);
+    decodeSRuns(bitseqR,bitseqRinv,d,out);
+    delete[]d;
+}
+
+template <class T>
+void Theorem2T<T>::decodeInverse(T* out){
+    T* d = new T[th1->length()];
+    th1->decodeInverse(d);
+    decodeSRuns(bitseqRinv,bitseqR,d,out);
+    delete[]d;
+}
+
+/* the k-th SRun starts at the k-th one of from and is mapped to the
+ * consecutive positions starting at the (d[k]+1)-th one of to */
+template <class T>
+void Theorem2T<T>::decodeSRuns(Bitseq* from, Bitseq* to, T* d, T* out){
+    Index tau=th1->length(), words=(this->len+W-1)/W;
+    Index* starts[2] = {new Index[tau+1], new Index[tau+1]};
+    Bitseq* bs[2] = {from,to};
+    uint* bitmap = new uint[words];
+    for(int b=0; b<2; b++){
+        bs[b]->get_bitmap(bitmap);
+        Index k=0;
+        for(Index w=0; w<words; w++)
+            for(uint word=bitmap[w]; word; word&=word-1)
+                starts[b][k++] = w*W+__builtin_ctz(word);
+        starts[b][tau]=this->len;
+    }
+    delete[]bitmap;
+
+    for(Index k=0; k<tau; k++){
+        T target = starts[1][d[k]];
+        for(Index i=starts[0][k]; i<starts[0][k+1]; i++)
+            out[i] = target++;
+    }
+    delete[]starts[0];
+    delete[]starts[1];
+}
+
 /* saves structure TH2's bitmaps into files with prefix "fname"
  * - first: th1 structure
+ * - then: 1 if R and Rinv are Elias-Fano, 0 otherwise
  * - second: bitsequence R
  * - third: bitsequence Rinv
  */
-int Theorem2::save (char* fname){
+template <class T>
+int Theorem2T<T>::save (char* fname){
 	int ret = th1->save(fname);
 	FILE * output;
     output = fopen(fname,"ab");
-    if(bitseqR->save(output)!=0) return -1;
-    if(bitseqRinv->save(output)!=0) return -1;
+    uint sparse = dynamic_cast<static_bitsequence_eliasfano*>(bitseqR)!=0;
+    if(fwrite(&sparse,sizeof(uint),1,output)!=1) return -1;
+    Bitseq* bs[2] = {bitseqR, bitseqRinv};
+    for(int k=0; k<2; k++)
+        if((sparse ? bs[k]->save(output) : Node::bitseqSave(bs[k],output))!=0) return -1;
     fclose(output);
     return ret;
 }
@@ -186,7 +383,8 @@ int Theorem2::save (char* fname){
  * - fname contains both the th1 structure and the R and Rinv bitmaps
  * - fname.idx: contains the three shape
  */
-int Theorem2::load (char* fname){
+template <class T>
+int Theorem2T<T>::load (char* fname){
 	char fname2[128];
 	strcpy(fname2,fname);
 	strcat(fname2,".idx");
@@ -196,32 +394,28 @@ int Theorem2::load (char* fname){
 	FILE * hierarchy;
 	hierarchy = fopen(fname2,"rb");
 
-    th1 = new Theorem1();
+    th1 = new Theorem1T<T>();
     int ret = th1->loadWT(input,hierarchy);
 	if(ret==-1){
 		cout<<"@Theorem1::load()\n";
 		return -1;
 	}
 
-	switch(bitseqFlag){//bitseqFlag defined at runtime
-		case RRR:
-			bitseqR = static_bitsequence_rrr02::load(input);
-			bitseqRinv = static_bitsequence_rrr02::load(input);
-			break;
-		case RRRL:
-			bitseqR = static_bitsequence_rrr02_light::load(input);
-			bitseqRinv = static_bitsequence_rrr02_light::load(input);
-			break;
-		default:
-			bitseqR = static_bitsequence_brw32::load(input);
-			bitseqRinv = static_bitsequence_brw32::load(input);
-			break;
+	uint sparse;
+	if(fread(&sparse,sizeof(uint),1,input)!=1) return -1;
+	if(sparse){
+		bitseqR = bitseqSparseLoader(input);
+		bitseqRinv = bitseqSparseLoader(input);
+	}
+	else{
+		bitseqR = Node::bitseqLoader(input);
+		bitseqRinv = Node::bitseqLoader(input);
 	}
 
     if(!bitseqR) return -1;
     if(!bitseqRinv) return -1;
 
-    len = bitseqR->length();
+    this->len = bitseqR->length();
 
 	#ifdef PRINT
 	cout<<"\n";
@@ -232,14 +426,22 @@ int Theorem2::load (char* fname){
 	return ret;
 }
 
-int Theorem2::size (){
-    return sizeof(Theorem2) + th1->size() + bitseqR->size() + bitseqRinv->size();
+template <class T>
+size_t Theorem2T<T>::size (){
+    return sizeof(Theorem2T) + th1->size() + bitseqR->size() + bitseqRinv->size();
 }
 
-unsigned int Theorem2::bitsRequired (){
-    unsigned int bitsReq = th1->bitsRequired();
-    //bits for R and Rinv: (#int) bitmapR + (#int) rank&select overhead (5%) + variable: size
-    bitsReq += 2*((bitseqR->length()/W+1 + bitseqR->length()/(W*FACTOR)+1 +1)*W);
+template <class T>
+size_t Theorem2T<T>::bitsRequired (){
+    size_t bitsReq = th1->bitsRequired();
+    static_bitsequence_eliasfano* ef = dynamic_cast<static_bitsequence_eliasfano*>(bitseqR);
+    if(ef)
+        //bits for R and Rinv: Elias-Fano lows + highs + select samples
+        bitsReq += ef->SpaceRequirementInBits()
+                 + dynamic_cast<static_bitsequence_eliasfano*>(bitseqRinv)->SpaceRequirementInBits();
+    else
+        //bits for R and Rinv: (#int) bitmapR + (#int) rank&select overhead (5%) + variable: size
+        bitsReq += 2*((bitseqR->length()/W+1 + bitseqR->length()/(W*FACTOR)+1 +1)*W);
     return bitsReq;
 }
 
@@ -25,91 +25,225 @@
 #include<iostream>
 #include<math.h>
 #include<static_bitsequence.h>
+#include"buildprofile.h"
+#include"bitseqflag.h"
 
 using namespace std;
 
-/** Auxiliar class to handle nodes of a wavelet tree like structure.
+/** Auxiliar class to handle nodes of a wavelet tree like structure. I is the
+ *  type of the positions: the nodes of WTNode (uint) hold the bitsequences
+ *  chosen by bitseqFlag, and the ones of 64-bit positions a
+ *  static_bitsequence_brw64_large, whatever the flag.
  *
  *  @author Carlos Bedregal
  */
 
-class WTNode{
+template <class I>
+class WTNodeT{
     public:
-    static_bitsequence* bitseq; //estructure for rank & select
-    WTNode* children[2]; //array of children: 0=left, 1=right
+    typedef typename static_bitsequence_of<I>::type Bitseq;
+
+    Bitseq* bitseq; //estructure for rank & select
+    WTNodeT* children[2]; //array of children: 0=left, 1=right
+    I zeros; //rank0 of the whole bitmap, kept for the traversals
+    WTNodeT* parent; //set by Theorem1::buildLeafIndex, 0 otherwise
 
     public:
-    WTNode();
-    WTNode(int s);
-    ~WTNode();
+    WTNodeT();
+    WTNodeT(I s);
+    ~WTNodeT();
     void print();
-    void createBitseq(uint* bitmap, uint size);
-    static static_bitsequence* bitseqCreator(uint* bitmap, uint size);
+    void createBitseq(uint* bitmap, I size, bool keep=false);
+    static Bitseq* bitseqCreator(uint* bitmap, I size, bool keep=false);
+    static static_bitsequence* bitseqOfType(int type, uint* bitmap, uint size, bool keep=false);
+    static int bitseqChoice(uint* bitmap, uint size);
+    static bool bitseqKeepsBitmap();
+    static Bitseq* bitseqLoader(FILE * fp);
+    static int bitseqSave(Bitseq* bs, FILE * fp);
     int save(FILE * fp);
     int load(FILE * fp);
-    int size();
+    size_t size();
+
+    /* select sampling used for the brw32 bitsequences (0=no sampling) */
+    static uint selectSampling;
+
+    /* policy of bitseqFlag ADAPTIVE, see bitseqChoice: a node takes rrr63
+     * if its estimated size is at most adaptiveRatio times the one of brw32
+     * (0=always brw32, faster; larger values favour space), and it has at
+     * least adaptiveMinBits bits */
+    static double adaptiveRatio;
+    static uint adaptiveMinBits;
 };
 
-WTNode::WTNode(){
+typedef WTNodeT<uint> WTNode;
+
+/* bitsequence of the sparse bitmaps over positions I (run starts of the leaf
+ * index, R and Rinv of Theorem2): Elias-Fano for uint, there is no 64-bit
+ * one so the large positions take brw64 */
+template <class I>
+struct WTSparse{ typedef static_bitsequence_eliasfano type; };
+template <>
+struct WTSparse<unsigned long long>{ typedef static_bitsequence_brw64_large type; };
+
+template <class I>
+uint WTNodeT<I>::selectSampling = SELECT_SAMPLING;
+template <class I>
+double WTNodeT<I>::adaptiveRatio = 0.5;
+template <class I>
+uint WTNodeT<I>::adaptiveMinBits = 1<<12;
+
+template <class I>
+WTNodeT<I>::WTNodeT(){
     children[0]=children[1]=0;
+    zeros=0;
+    parent=0;
 }
 
-WTNode::WTNode(int s){
+template <class I>
+WTNodeT<I>::WTNodeT(I s){
     //size=s;
     #ifdef VERBOSE
         cout<<"size: "<<s<<", bitmap["<<uint_len(s,1)<<"]\n";
     #endif //VERBOSE
     children[0]=children[1]=0;
     bitseq=0;
+    zeros=0;
+    parent=0;
 }
 
-WTNode::~WTNode(){
+template <class I>
+WTNodeT<I>::~WTNodeT(){
     if(bitseq) delete bitseq;
 }
 
-void WTNode::print(){
+template <class I>
+void WTNodeT<I>::print(){
     cout<<"["<<bitseq->length()<<"]: ";
-    for(uint q=0; q<bitseq->length(); q++)
+    for(I q=0; q<bitseq->length(); q++)
         cout<<bitseq->access(q)<<" ";
     cout<<endl;
 }
 
-void WTNode::createBitseq(uint* bitmap, uint size){
-    //bitseq = WTNode::bitseqCreator(bitmap,size);
-    bitseq = new static_bitsequence_brw32(bitmap,size,FACTOR);
+template <class I>
+void WTNodeT<I>::createBitseq(uint* bitmap, I size, bool keep){
+    bitseq = bitseqCreator(bitmap,size,keep);
+    zeros = bitseq->rank0(size-1);
+}
+
+/* with keep (only if bitseqKeepsBitmap()) the bitsequence uses the words of
+ * bitmap (size/W+1 of them) in place, and the caller keeps them alive */
+template <class I>
+typename WTNodeT<I>::Bitseq* WTNodeT<I>::bitseqCreator(uint* bitmap, I size, bool keep){
+    BuildTimer timer(PH_BITSEQ,false);
+    int type = bitseqFlag==ADAPTIVE ? bitseqChoice(bitmap,size) : bitseqFlag;
+    static_bitsequence* bs = bitseqOfType(type,bitmap,size,keep);
+    BuildProfile::alloc(PH_BITSEQ,bs->size());
+    return bs;
 }
 
-static_bitsequence* WTNode::bitseqCreator(uint* bitmap, uint size){
-    switch(bitseqFlag){//bitseqFlag defined at runtime
+template <class I>
+static_bitsequence* WTNodeT<I>::bitseqOfType(int type, uint* bitmap, uint size, bool keep){
+    switch(type){
         case RRR:
             return (new static_bitsequence_rrr02(bitmap,size));
         case RRRL:
             return (new static_bitsequence_rrr02_light(bitmap,size));
+        case BRW64:
+            return (new static_bitsequence_brw64(bitmap,size,FACTOR64));
+        case INTERLEAVED:
+            return (new static_bitsequence_interleaved(bitmap,size,selectSampling));
+        case RRR63:
+            return (new static_bitsequence_rrr63(bitmap,size));
         default:
-            return (new static_bitsequence_brw32(bitmap,size,FACTOR));
+            return (new static_bitsequence_brw32(bitmap,size,FACTOR,selectSampling,!keep));
     }
 }
 
-int WTNode::save(FILE * fp){
-    #ifdef DEBUG3
-        cout<<this<<": bitseq: len "<<bitseq->length()<<", bytes "<<bitseq->size()<<endl;
-    #endif //DEBUG3
-    return bitseq->save(fp);
+/* type (bitseqFlag value) of the bitsequence of a node under ADAPTIVE: brw32
+ * takes size*(1+1/FACTOR) bits, and rrr63 is estimated from the ones of
+ * each 64 bits (class and offset of its blocks) plus its samples. Nodes
+ * merging a long run with a short one are mostly zeros, and take rrr63 */
+template <class I>
+int WTNodeT<I>::bitseqChoice(uint* bitmap, uint size){
+    static double offsetBits[65];
+    static bool init = [](){ //ceil(log2 C(64,k)), once for all the threads
+        for(int k=0; k<=64; k++)
+            offsetBits[k] = ceil((lgamma(65.0)-lgamma(k+1.0)-lgamma(65.0-k))/log(2.0)-1e-9);
+        return true;
+    }();
+    (void)init;
+    if(size<adaptiveMinBits || adaptiveRatio<=0) return BRW;
+    double brw = size*(1+1.0/FACTOR);
+    double rrr = 2.0*W*size/(BLOCK_SIZE63*DEFAULT_SAMPLING63);
+    uint words = uint_len(size,1);
+    for(uint k=0; k+1<words; k+=2)
+        rrr += CLASS_BITS63 + offsetBits[popcount(bitmap[k])+popcount(bitmap[k+1])];
+    if(words%2) //last word, its bits beyond size are not read
+        rrr += CLASS_BITS63 + offsetBits[popcount(bitmap[words-1] & (size%W ? (1u<<(size%W))-1 : ~0u))];
+    return rrr <= adaptiveRatio*brw ? RRR63 : BRW;
 }
 
-int WTNode::load(FILE * fp){
-	//bitseq = static_bitsequence::load(fp);
+/* true if the bitsequences of bitseqFlag can keep the bitmap they are built
+ * from, see bitseqCreator */
+template <class I>
+bool WTNodeT<I>::bitseqKeepsBitmap(){
+    switch(bitseqFlag){
+        case RRR: case RRRL: case BRW64: case INTERLEAVED: case RRR63: case ADAPTIVE:
+            return false;
+        default:
+            return true;
+    }
+}
 
-	switch(bitseqFlag){//bitseqFlag defined at runtime
+/* under ADAPTIVE each bitsequence is preceded by its type, see bitseqSave */
+template <class I>
+typename WTNodeT<I>::Bitseq* WTNodeT<I>::bitseqLoader(FILE * fp){
+    static_bitsequence_brw32* brw;
+    int type=bitseqFlag;
+    if(type==ADAPTIVE && fread(&type,sizeof(int),1,fp)!=1) return 0;
+	switch(type){
 		case RRR:
-			bitseq = static_bitsequence_rrr02::load(fp); break;
+			return static_bitsequence_rrr02::load(fp);
 		case RRRL:
-			bitseq = static_bitsequence_rrr02_light::load(fp); break;
+			return static_bitsequence_rrr02_light::load(fp);
+		case BRW64:
+			return static_bitsequence_brw64::load(fp);
+		case INTERLEAVED:
+			return static_bitsequence_interleaved::load(fp);
+		case RRR63:
+			return static_bitsequence_rrr63::load(fp);
 		default:
-			bitseq = static_bitsequence_brw32::load(fp); break;
+			brw = static_bitsequence_brw32::load(fp);
+			if(brw && selectSampling) brw->create_select_sampling(selectSampling);
+			return brw;
 	}
+}
+
+/* saves bs as bitseqLoader reads it, under ADAPTIVE with its type first */
+template <class I>
+int WTNodeT<I>::bitseqSave(Bitseq* bs, FILE * fp){
+    if(bitseqFlag==ADAPTIVE){
+        int type = dynamic_cast<static_bitsequence_rrr63*>(bs) ? RRR63 : BRW;
+        if(fwrite(&type,sizeof(int),1,fp)!=1) return -1;
+    }
+    return bs->save(fp);
+}
+
+template <class I>
+int WTNodeT<I>::save(FILE * fp){
+    #ifdef DEBUG3
+        cout<<this<<": bitseq: len "<<bitseq->length()<<", bytes "<<bitseq->size()<<endl;
+    #endif //DEBUG3
+    return bitseqSave(bitseq,fp);
+}
+
+template <class I>
+int WTNodeT<I>::load(FILE * fp){
+	//bitseq = static_bitsequence::load(fp);
+	bitseq = bitseqLoader(fp);
 
     if(bitseq){
+        zeros = bitseq->rank0(bitseq->length()-1);
         #ifdef DEBUG2
             cout<<this<<": bitseq: len "<<bitseq->length()<<", bytes "<<bitseq->size()<<endl;
         #endif //DEBUG2
@@ -122,8 +256,34 @@ int WTNode::load(FILE * fp){
     return -1;
 }
 
-int WTNode::size(){
-    return bitseq->size() + sizeof(WTNode) - sizeof(uint);
+template <class I>
+size_t WTNodeT<I>::size(){
+    return bitseq->size() + sizeof(WTNodeT);
+}
+
+/* the nodes of 64-bit positions take brw64 of 64-bit counters, and own
+ * their words */
+template <>
+inline WTNodeT<unsigned long long>::Bitseq* WTNodeT<unsigned long long>::bitseqCreator(uint* bitmap, unsigned long long size, bool keep){
+    BuildTimer timer(PH_BITSEQ,false);
+    Bitseq* bs = new static_bitsequence_brw64_large(bitmap,size,FACTOR64);
+    BuildProfile::alloc(PH_BITSEQ,bs->size());
+    return bs;
+}
+
+template <>
+inline bool WTNodeT<unsigned long long>::bitseqKeepsBitmap(){
+    return false;
+}
+
+template <>
+inline WTNodeT<unsigned long long>::Bitseq* WTNodeT<unsigned long long>::bitseqLoader(FILE * fp){
+    return static_bitsequence_brw64_large::load(fp);
+}
+
+template <>
+inline int WTNodeT<unsigned long long>::bitseqSave(Bitseq* bs, FILE * fp){
+    return bs->save(fp);
 }
 
 #endif // WAVELETNODE_H_INCLUDED
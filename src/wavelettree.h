@@ -22,41 +22,90 @@
 #ifndef WAVELETTREE_H_INCLUDED
 #define WAVELETTREE_H_INCLUDED
 
+#include <thread>
+#include <vector>
+#include <atomic>
 #include "hutucker.h"
 #include "waveletnode.h"
 
 using namespace std;
 
+//nodes (and subtrees) of fewer elements are built by a single thread
+#define WT_PAR_THRESHOLD (1<<16)
+
+/** Buffers of the construction of a wavelet tree, shared by its threads.
+ *  The merged values of the nodes at even depth go to array and the ones
+ *  at odd depth to tmp, so each node reads its children from one buffer
+ *  and writes the other (ping-pong) at the positions it covers, and nothing
+ *  is copied back. Bitmaps come from a single block of words: when the
+ *  bitsequences keep them (brw32) each node bumps its own slice, kept by
+ *  the tree; otherwise the node with first run r and first position e
+ *  writes from word e/W+r, a slice that does not overlap the ones of the
+ *  nodes built at the same time, and the block is freed after the build.
+ */
+template <class T>
+struct WTBuild{
+    T* buf[2]; //array and tmp
+    uint* words; //bitmaps
+    bool keep; //the bitsequences keep their words
+    atomic<size_t> used; //words bumped from words (keep)
+};
+
 /** Class for wavelet tree data structure. Builds a wavelet tree form a Hu-Tucker shaped binarytrie,
  *  it also sorts (merging the nodes) the original permutation.
  *
+ *  The construction merges the runs bottom-up in the buffers of WTBuild.
+ *  With buildThreads>1 it is fork-join: the two subtrees of a
+ *  node cover disjoint ranges of array and are built at the same time, the
+ *  threads split between them by weight. The merge of a large node is split
+ *  into ranges of the output (merge path), each starting at a multiple of
+ *  W so every word of the bitmap is written by a single thread.
+ *
+ *  Positions are of the unsigned type of T (Index), and so are the nodes:
+ *  WaveletTree<int> has the 32-bit WTNode, WaveletTree<long long> the nodes
+ *  of 64-bit positions.
+ *
  *  @author Carlos Bedregal
  */
 
 template <class T>
 class WaveletTree{
     public:
+    typedef typename make_unsigned<T>::type Index;
+    typedef WTNodeT<Index> Node;
+
     T* array; //array of values
     //HuTucker<T>* ht; //pointer to HuTucker tree
-    WTNode* root;
-    int weight;
+    Node* root;
+    Index weight; //internal nodes
+    uint* arena; //bitmaps kept by the nodes, 0 if they own them
 
     public:
     WaveletTree();
     WaveletTree(HuTucker<T>* ht, T* array);
-    WaveletTree(T* array, int* runs, int ro);
+    WaveletTree(T* array, T* runs, Index ro);
     ~WaveletTree();
-    void recBuild(BNode<T>* bNode, WTNode* wNode);
-    void recPrint(WTNode* node);
-    void recDestruct(WTNode* node);
-    void recBitsRequired(WTNode* node, unsigned int& bitsReq);
+    void build(HuTucker<T>* ht);
+    Index recBuild(BNode<T>* bNode, Node* wNode, WTBuild<T>& ctx, int depth, int threads);
+    void mergeRange(BNode<T>* bNode, T* src, T* dst, uint* bitmap, Index from, Index to);
+    static size_t recArenaWords(BNode<T>* bNode);
+    void recPrint(Node* node);
+    void recDestruct(Node* node);
+    void recBitsRequired(Node* node, size_t& bitsReq);
+
+    /* threads used by the construction (1=sequential) */
+    static int buildThreads;
 };
 
+template <class T>
+int WaveletTree<T>::buildThreads = 1;
+
 template <class T>
 WaveletTree<T>::WaveletTree(){
     array=0;
     root=0;
     weight=0;
+    arena=0;
 }
 
 template <class T>
@@ -64,14 +113,11 @@ WaveletTree<T>::WaveletTree(HuTucker<T>* ht, T* array){
     assert(ht!=0);
     assert(array!=0);
     this->array=array;
-    root=new WTNode(ht->root->w);
-    weight=1;
-    recBuild(ht->root, root);
-    assert(weight==ht->weight);
+    build(ht);
 }
 
 template <class T>
-WaveletTree<T>::WaveletTree(T* array, int* runs, int ro){
+WaveletTree<T>::WaveletTree(T* array, T* runs, Index ro){
     #ifdef PRINT
         cout<<"- Building WaveletTree: "<<ro<<" run\n";
     #endif //PRINT
@@ -82,14 +128,11 @@ WaveletTree<T>::WaveletTree(T* array, int* runs, int ro){
 
     HuTucker<T>* ht = new HuTucker<T>(runs,ro);
     //HuTucker<T>* ht = new HuTucker<T>(p);
-    assert(ht->len=ro);
+    assert((Index)ht->len==ro);
     assert(ht->root!=0);
 
-    root=new WTNode(ht->root->w);
-    weight=1;
-    recBuild(ht->root, root);
+    build(ht);
 
-    assert(weight==ht->weight);
     #ifdef PRINT
         cout<<"- "<<weight<<" nodes\n";
     #endif //PRINT
@@ -100,71 +143,153 @@ WaveletTree<T>::WaveletTree(T* array, int* runs, int ro){
 template <class T>
 WaveletTree<T>::~WaveletTree(){
     recDestruct(root);
+    delete[]arena;
+}
+
+/* builds the nodes of the tree with the shape of ht, sorting array */
+template <class T>
+void WaveletTree<T>::build(HuTucker<T>* ht){
+    BuildTimer timer(PH_WT_BUILD);
+    BNode<T>* bRoot=ht->root;
+    Index n=bRoot->w;
+    WTBuild<T> ctx;
+    ctx.buf[0]=array;
+    ctx.buf[1]=new T[n];
+    ctx.keep=Node::bitseqKeepsBitmap();
+    ctx.used=0;
+    arena=0;
+    if(ctx.keep)
+        ctx.words = arena = new uint[recArenaWords(bRoot)];
+    else
+        ctx.words = new uint[n/W+ht->len+1];
+    BuildProfile::alloc(PH_WT_BUILD,n*sizeof(T));
+    BuildProfile::alloc(PH_WT_BUILD,(ctx.keep ? recArenaWords(bRoot) : n/W+ht->len+1)*sizeof(uint));
+
+    root=new Node(n);
+    weight=1+recBuild(bRoot, root, ctx, 0, buildThreads);
+    assert(weight==(Index)ht->weight);
+
+    delete[]ctx.buf[1];
+    if(!ctx.keep) delete[]ctx.words;
+}
+
+/* words of the bitmaps of the internal nodes below bNode (w/W+1 each) */
+template <class T>
+size_t WaveletTree<T>::recArenaWords(BNode<T>* bNode){
+    if(bNode->type==0) return 0;
+    return bNode->w/W+1 + recArenaWords(bNode->children[0]) + recArenaWords(bNode->children[1]);
 }
 
+/* builds the subtree of wNode (at the given depth) with the given threads,
+ * returns the number of nodes created below wNode */
 template <class T>
-void WaveletTree<T>::recBuild(BNode<T>* bNode, WTNode* wNode){
-    //build nodes on the wavelet-tree only for internal nodes of hu-tucker
-    if(bNode->children[0]->type!=0){
-        weight++;
-        wNode->children[0]=new WTNode(bNode->children[0]->w);
-        recBuild(bNode->children[0],wNode->children[0]);
+typename WaveletTree<T>::Index WaveletTree<T>::recBuild(BNode<T>* bNode, Node* wNode, WTBuild<T>& ctx, int depth, int threads){
+    BNode<T>* bLeft=bNode->children[0];
+    BNode<T>* bRight=bNode->children[1];
+    T* src=ctx.buf[(depth+1)%2];
+    T* dst=ctx.buf[depth%2];
+    Index nodes=0;
+
+    //build nodes on the wavelet-tree only for internal nodes of hu-tucker,
+    //the runs of the leaves are moved to the buffer read by the merge
+    BNode<T>* bChild[2] = {bLeft, bRight};
+    for(int c=0; c<2; c++){
+        if(bChild[c]->type!=0)
+            wNode->children[c]=new Node(bChild[c]->w);
+        else if(src!=array)
+            for(T k=bChild[c]->endpoint[0]; k<=bChild[c]->endpoint[1]; k++)
+                src[k]=array[k];
     }
-    if(bNode->children[1]->type!=0){
-        weight++;
-        wNode->children[1]=new WTNode(bNode->children[1]->w);
-        recBuild(bNode->children[1],wNode->children[1]);
+    if(threads>1 && bLeft->type!=0 && bRight->type!=0
+       && min(bLeft->w,bRight->w)>=WT_PAR_THRESHOLD){
+        int tl = (int)((long long)threads*bLeft->w/bNode->w);
+        tl = tl<1 ? 1 : (tl>threads-1 ? threads-1 : tl);
+        Index nLeft=0;
+        thread left([&](){ nLeft=recBuild(bLeft,wNode->children[0],ctx,depth+1,tl); });
+        nodes=2+recBuild(bRight,wNode->children[1],ctx,depth+1,threads-tl);
+        left.join();
+        nodes+=nLeft;
+    }
+    else{
+        if(bLeft->type!=0) nodes+=1+recBuild(bLeft,wNode->children[0],ctx,depth+1,threads);
+        if(bRight->type!=0) nodes+=1+recBuild(bRight,wNode->children[1],ctx,depth+1,threads);
     }
 
     //merge of nodes (merge both bitmaps and sort the area covered by the nodes)
-    int i,j,k;
-    uint* bitmap = new uint[uint_len(bNode->w,1)];
-    //int* mergeArea=new int[wNode->size];
-    int* mergeArea=new int[bNode->w];
-    for(i=0,j=bNode->children[1]->w-1,k=0; i<bNode->children[0]->w && j>=0; k++){
-        if(array[bNode->endpoint[0]+i]<array[bNode->endpoint[1]-j]){
-            //bitclean(wNode->bitmap,k);
-            bitclean(bitmap,k);
-            mergeArea[k]=array[bNode->endpoint[0]+i];
-            i++;
+    Index n=bNode->w;
+    uint* bitmap = ctx.keep ? ctx.words+ctx.used.fetch_add(n/W+1)
+                            : ctx.words+bNode->endpoint[0]/W+bNode->pos;
+    {
+    BuildTimer timer(PH_WT_MERGE,false);
+    bitmap[n/W]=0;
+    int parts = (threads>1 && n>=WT_PAR_THRESHOLD) ? threads : 1;
+    if(parts==1)
+        mergeRange(bNode,src,dst,bitmap,0,n);
+    else{
+        vector<thread> pool;
+        for(int p=0; p<parts; p++){
+            Index from = (Index)((unsigned long long)n*p/parts/W*W);
+            Index to = p+1<parts ? (Index)((unsigned long long)n*(p+1)/parts/W*W) : n;
+            pool.push_back(thread(&WaveletTree<T>::mergeRange,this,bNode,src,dst,bitmap,from,to));
         }
-        else{
-            //bitset(wNode->bitmap,k);
-            bitset(bitmap,k);
-            mergeArea[k]=array[bNode->endpoint[1]-j];
-            j--;
-        }
-    }
-    for(; i<bNode->children[0]->w; i++,k++){
-        //bitclean(wNode->bitmap,k);
-        bitclean(bitmap,k);
-        mergeArea[k]=array[bNode->endpoint[0]+i];
+        for(int p=0; p<parts; p++) pool[p].join();
     }
-    for(; j>=0; j--,k++){
-        //bitset(wNode->bitmap,k);
-        bitset(bitmap,k);
-        mergeArea[k]=array[bNode->endpoint[1]-j];
     }
-    //for(k=0; k<wNode->size; k++)
-    for(k=0; k<bNode->w; k++)
-        array[k+bNode->endpoint[0]]=mergeArea[k];
     //end of merge
 
-    //wNode->createBitseq();
-    wNode->createBitseq(bitmap,bNode->w);
-
-    #ifdef DEBUG
-    //for(k=0; k<root->size; k++)
-    //    cout<<array[k]<<" ";
-    //cout<<endl;
-    #endif //DEBUG
+    wNode->createBitseq(bitmap,n,ctx.keep);
+    return nodes;
+}
 
-    delete[]bitmap;
-    delete[]mergeArea;
+/* positions [from,to) of the merge of the two children of bNode, read from
+ * src and written to dst, from is a multiple of W. The run of the left
+ * child starts at endpoint[0] and the one of the right child ends at
+ * endpoint[1]. The elements of the left child before from are found by
+ * binary search (merge path) */
+template <class T>
+void WaveletTree<T>::mergeRange(BNode<T>* bNode, T* src, T* dst, uint* bitmap, Index from, Index to){
+    Index nl=bNode->children[0]->w, nr=bNode->children[1]->w;
+    T* left=src+bNode->endpoint[0];
+    T* right=src+bNode->endpoint[1]-nr+1;
+    T* mergeArea=dst+bNode->endpoint[0];
+    Index lo = from>nr ? from-nr : 0, hi = from<nl ? from : nl;
+    while(lo<hi){
+        Index mid=(lo+hi)/2;
+        if(left[mid]<right[from-mid-1]) lo=mid+1;
+        else hi=mid;
+    }
+    Index i=lo, j=from-lo, k=from;
+    uint word=0;
+    //both runs have elements left, without branches on the comparison
+    for(; k<to && i<nl && j<nr; k++){
+        T x=left[i], y=right[j];
+        uint r = !(x<y);
+        mergeArea[k] = r ? y : x;
+        word |= r<<(k%W);
+        i+=1-r;
+        j+=r;
+        if(k%W==W-1){
+            bitmap[k/W]=word;
+            word=0;
+        }
+    }
+    for(; k<to; k++){
+        if(i<nl)
+            mergeArea[k]=left[i++];
+        else{
+            word |= 1u<<(k%W);
+            mergeArea[k]=right[j++];
+        }
+        if(k%W==W-1){
+            bitmap[k/W]=word;
+            word=0;
+        }
+    }
+    if(k%W) bitmap[k/W]=word;
 }
 
 template <class T>
-void WaveletTree<T>::recPrint(WTNode* node){
+void WaveletTree<T>::recPrint(Node* node){
     if(!node){
         cout<<"null\n"; return;
     }
@@ -176,7 +301,7 @@ void WaveletTree<T>::recPrint(WTNode* node){
 }
 
 template <class T>
-void WaveletTree<T>::recDestruct(WTNode* node){
+void WaveletTree<T>::recDestruct(Node* node){
     if(!node) return;
     recDestruct(node->children[0]);
     recDestruct(node->children[1]);
@@ -184,8 +309,8 @@ void WaveletTree<T>::recDestruct(WTNode* node){
 }
 
 template <class T>
-void WaveletTree<T>::recBitsRequired(WTNode* node, unsigned int& bitsReq){
-	int nodeBits = node->bitseq->length();
+void WaveletTree<T>::recBitsRequired(Node* node, size_t& bitsReq){
+	Index nodeBits = node->bitseq->length();
 	//bits requiered for: [  (#ints) node's bitmap   +   (#ints) rank&select (5%)  ] * W=32
     bitsReq += (nodeBits/W+1 + nodeBits/(W*FACTOR)+1)*W;  //((static_bitsequence_brw32*)node->bitseq)->SpaceRequirementInBits();
     //bits requiered for rank&select constants: size of bitmap         //WARNING: the real implementation considers 3 constants: size+factor+flag
@@ -0,0 +1,370 @@
+/* wtexternal.h
+   Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+
+   Implementation of Compressed Representation of Permutations: Runs & SRuns.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef WTEXTERNAL_H_INCLUDED
+#define WTEXTERNAL_H_INCLUDED
+
+#include<cstdio>
+#include<vector>
+#include<limits>
+#include"theorem1.h"
+
+//bytes of each buffer of the external construction
+#define WTEXT_BUFFER (1<<22)
+
+/** Buffered sequential reader of count values of type T of a file, starting
+ *  at value offset.
+ *
+ *  @author Carlos Bedregal
+ */
+template <class T>
+class WTExtReader{
+    public:
+    FILE* fp;
+    T* buf;
+    size_t cap, pos, len;
+    long long left; //values not yet read into buf
+
+    WTExtReader(){ fp=0; buf=0; cap=pos=len=0; left=0; }
+    ~WTExtReader(){ close(); }
+
+    bool open(const char* fname, long long offset, long long count, size_t bytes){
+        fp=fopen(fname,"rb");
+        if(!fp || fseeko(fp,(off_t)offset*sizeof(T),SEEK_SET)!=0) return false;
+        cap=bytes/sizeof(T);
+        if(cap==0) cap=1;
+        buf=new T[cap];
+        pos=len=0;
+        left=count;
+        return true;
+    }
+
+    void close(){
+        if(fp) fclose(fp);
+        delete[]buf;
+        fp=0; buf=0;
+    }
+
+    /* true if there is a value at the front, refilling buf if needed */
+    inline bool more(){
+        if(pos<len) return true;
+        if(left<=0) return false;
+        size_t want = left<(long long)cap ? (size_t)left : cap;
+        len=fread(buf,sizeof(T),want,fp);
+        pos=0;
+        left-=len;
+        if(len==0) left=0;
+        return len>0;
+    }
+
+    inline T front(){ return buf[pos]; }
+    inline void pop(){ pos++; }
+};
+
+/** Buffered writer of values of type T to a file.
+ *
+ *  @author Carlos Bedregal
+ */
+template <class T>
+class WTExtWriter{
+    public:
+    FILE* fp;
+    T* buf;
+    size_t cap, len;
+    bool fail;
+
+    WTExtWriter(){ fp=0; buf=0; cap=len=0; fail=false; }
+    ~WTExtWriter(){ close(); }
+
+    bool open(const char* fname, size_t bytes){
+        fp=fopen(fname,"wb");
+        cap=bytes/sizeof(T);
+        if(cap==0) cap=1;
+        buf=new T[cap];
+        len=0;
+        fail = fp==0;
+        return !fail;
+    }
+
+    inline void push(T x){
+        buf[len++]=x;
+        if(len==cap) flush();
+    }
+
+    void flush(){
+        if(len && fwrite(buf,sizeof(T),len,fp)!=len) fail=true;
+        len=0;
+    }
+
+    /* returns false if some write failed */
+    bool close(){
+        if(fp){
+            flush();
+            FILE* f=fp;
+            fp=0;
+            if(fclose(f)!=0) fail=true;
+        }
+        delete[]buf;
+        buf=0;
+        return !fail;
+    }
+};
+
+/** Construction of Theorem1T<T> for permutations stored in a file (raw
+ *  values of type T), without loading them in memory. It writes the files
+ *  of Theorem1T<T>::save, which Theorem1T<T>::load reads back:
+ *  - one pass over the input finds the Runs, and the Hu-Tucker shape is
+ *    built from their lengths alone;
+ *  - the internal nodes are built in post-order, each one merging the
+ *    values of its children (runs read from the input, or the files
+ *    written by its internal children) into a temporary file, with the
+ *    bitmap of the node in memory. The bitsequence of each node is saved
+ *    to its own temporary file;
+ *  - the bitsequences are concatenated in preorder into fname, and the
+ *    shape of the tree is written to fname.idx.
+ *  The memory used is three buffers, the run lengths, and the bitmap and
+ *  bitsequence of one node at a time (O(n) bits instead of O(n log n)).
+ *  The temporary files (fname.v<k>, fname.b<k>) take at most twice the
+ *  size of the input.
+ *
+ *  @author Carlos Bedregal
+ */
+template <class T>
+class WTExternalBuilderT{
+    public:
+    typedef typename make_unsigned<T>::type Index;
+    typedef typename WaveletTree<T>::Node Node;
+
+    char input[128];
+    char output[128];
+    size_t bufferBytes;
+    long long len; //values in input
+    std::vector<T> runs;
+    HuTucker<T>* ht;
+    Index nodes; //internal nodes, numbered in preorder
+
+    public:
+    WTExternalBuilderT(const char* input, size_t bufferBytes=WTEXT_BUFFER);
+    ~WTExternalBuilderT();
+    int build(const char* fname);
+    int findRuns();
+    int recBuild(BNode<T>* bNode, Index id, bool keepValues);
+    int recShape(BNode<T>* bNode, uint* shape, Index& curr);
+    void tmpName(char* name, char kind, Index id);
+};
+
+typedef WTExternalBuilderT<int> WTExternalBuilder;
+
+template <class T>
+WTExternalBuilderT<T>::WTExternalBuilderT(const char* input, size_t bufferBytes){
+    strncpy(this->input,input,sizeof(this->input)-1);
+    this->input[sizeof(this->input)-1]=0;
+    output[0]=0;
+    this->bufferBytes=bufferBytes;
+    len=0;
+    ht=0;
+    nodes=0;
+}
+
+template <class T>
+WTExternalBuilderT<T>::~WTExternalBuilderT(){
+    delete ht;
+}
+
+template <class T>
+void WTExternalBuilderT<T>::tmpName(char* name, char kind, Index id){
+    snprintf(name,160,"%s.%c%llu",output,kind,(unsigned long long)id);
+}
+
+/* one pass over input, the lengths of its Runs go to runs */
+template <class T>
+int WTExternalBuilderT<T>::findRuns(){
+    #ifdef PRINT
+        cout<<"\t- Identifying Runs (external)\n";
+    #endif //PRINT
+    WTExtReader<T> in;
+    if(!in.open(input,0,1LL<<62,bufferBytes)){
+        cout<<"@WTExternalBuilder::findRuns(): open "<<input<<endl;
+        return -1;
+    }
+    runs.clear();
+    len=0;
+    T last=0, curr=0;
+    while(in.more()){
+        T x=in.front(); in.pop();
+        if(len>0 && x<last){
+            runs.push_back(curr);
+            curr=0;
+        }
+        curr++;
+        last=x;
+        len++;
+    }
+    if(len>0) runs.push_back(curr);
+    return 0;
+}
+
+/* builds the Theorem1T<T> of the permutation in input into the files of
+ * Theorem1T<T>::save(fname) */
+template <class T>
+int WTExternalBuilderT<T>::build(const char* fname){
+    strncpy(output,fname,sizeof(output)-1);
+    output[sizeof(output)-1]=0;
+    if(findRuns()) return -1;
+    //positions of the tree are T, and a single run has no internal node
+    if((unsigned long long)len>(unsigned long long)(numeric_limits<T>::max)() || runs.size()<2){
+        cout<<"@WTExternalBuilder::build(): "<<len<<" values, "<<runs.size()<<" runs\n";
+        return -1;
+    }
+    delete ht;
+    ht=new HuTucker<T>(&runs[0],runs.size());
+    nodes=0;
+    if(recBuild(ht->root,nodes++,false)) return -1;
+    assert(nodes==(Index)ht->weight);
+
+    //bitsequences in preorder
+    char name[160];
+    FILE* out=fopen(output,"wb");
+    if(!out) return -1;
+    char* buf=new char[bufferBytes];
+    int ret=0;
+    for(Index id=0; id<nodes; id++){
+        tmpName(name,'b',id);
+        FILE* fp=fopen(name,"rb");
+        if(!fp){ ret=-1; break; }
+        size_t r;
+        while((r=fread(buf,1,bufferBytes,fp))>0)
+            if(fwrite(buf,1,r,out)!=r) ret=-1;
+        fclose(fp);
+        remove(name);
+    }
+    delete[]buf;
+    if(fclose(out)!=0) ret=-1;
+    if(ret) return ret;
+
+    //shape, as Theorem1T<T>::save
+    snprintf(name,160,"%s.idx",output);
+    Index words=(2*nodes+W-1)/W+1;
+    uint* shape=new uint[words];
+    for(Index k=0; k<words; k++) shape[k]=0;
+    Index curr=0;
+    recShape(ht->root,shape,curr);
+    FILE* hierarchy=fopen(name,"wb");
+    if(!hierarchy ||
+       fwrite(&curr,sizeof(Index),1,hierarchy)!=1 ||
+       fwrite(shape,sizeof(uint),words,hierarchy)!=words)
+        ret=-1;
+    if(hierarchy) fclose(hierarchy);
+    delete[]shape;
+    return ret;
+}
+
+/* builds the internal node bNode (preorder number id) after its internal
+ * children: merges their values into the file v<id> (unless it is the root)
+ * and saves its bitsequence into b<id> */
+template <class T>
+int WTExternalBuilderT<T>::recBuild(BNode<T>* bNode, Index id, bool keepValues){
+    BNode<T>* child[2] = {bNode->children[0], bNode->children[1]};
+    Index childId[2] = {0,0}; //0 for the leaves, the root is never a child
+    for(int c=0; c<2; c++){
+        if(child[c]->type==0) continue;
+        childId[c]=nodes++;
+        if(recBuild(child[c],childId[c],true)) return -1;
+    }
+
+    //sources: runs of the input, or values of the internal children
+    char name[160];
+    WTExtReader<T> src[2];
+    for(int c=0; c<2; c++){
+        bool ok;
+        if(!childId[c])
+            ok=src[c].open(input,child[c]->endpoint[0],child[c]->w,bufferBytes);
+        else{
+            tmpName(name,'v',childId[c]);
+            ok=src[c].open(name,0,child[c]->w,bufferBytes);
+        }
+        if(!ok){
+            cout<<"@WTExternalBuilder::recBuild(): source of node "<<id<<endl;
+            return -1;
+        }
+    }
+    WTExtWriter<T> dst;
+    if(keepValues){
+        tmpName(name,'v',id);
+        if(!dst.open(name,bufferBytes)) return -1;
+    }
+
+    //merge, bit 1 when the value comes from the right child
+    Index n=bNode->w;
+    uint* bitmap=new uint[(n+W-1)/W];
+    uint word=0;
+    Index k=0;
+    for(; k<n; k++){
+        bool r;
+        if(!src[0].more()) r=true;
+        else if(!src[1].more()) r=false;
+        else r = !(src[0].front()<src[1].front());
+        if(!src[r].more()) break; //input shorter than its runs
+        if(keepValues) dst.push(src[r].front());
+        src[r].pop();
+        word |= (uint)r<<(k%W);
+        if(k%W==W-1){
+            bitmap[k/W]=word;
+            word=0;
+        }
+    }
+    if(k%W) bitmap[k/W]=word;
+    bool ok = k==n && (!keepValues || dst.close());
+    for(int c=0; c<2; c++){
+        src[c].close();
+        if(childId[c]){
+            tmpName(name,'v',childId[c]);
+            remove(name);
+        }
+    }
+
+    //bitsequence of the node
+    if(ok){
+        typename Node::Bitseq* bs=Node::bitseqCreator(bitmap,n);
+        tmpName(name,'b',id);
+        FILE* fp=fopen(name,"wb");
+        ok = fp && Node::bitseqSave(bs,fp)==0;
+        if(fp && fclose(fp)!=0) ok=false;
+        delete bs;
+    }
+    delete[]bitmap;
+    if(!ok) cout<<"@WTExternalBuilder::recBuild(): node "<<id<<endl;
+    return ok ? 0 : -1;
+}
+
+/* preorder bits of the tree (1=internal node, 0=leaf), as Theorem1T<T>::recSave */
+template <class T>
+int WTExternalBuilderT<T>::recShape(BNode<T>* bNode, uint* shape, Index& curr){
+    if(bNode->type==0){
+        bitclean(shape,curr); curr++;
+        return 0;
+    }
+    bitset(shape,curr); curr++;
+    recShape(bNode->children[0],shape,curr);
+    return recShape(bNode->children[1],shape,curr);
+}
+
+#endif // WTEXTERNAL_H_INCLUDED
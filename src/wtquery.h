@@ -0,0 +1,397 @@
+/* wtquery.h
+   Copyright (C) 2009, Carlos Bedregal, all rights reserved.
+
+   Implementation of Compressed Representation of Permutations: Runs & SRuns.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef WTQUERY_H_INCLUDED
+#define WTQUERY_H_INCLUDED
+
+#include "theorem.h"
+#include "waveletnode.h"
+
+//nodes of the downward path kept by the iterative pi, deeper trees fall back
+//to the recursive traversal
+#define WT_MAXDEPTH 64
+
+/** Calls to the bitsequence of a node, with its type BS known at compile time.
+ *  The calls are qualified (BS::rank0) so they are bound statically and can be
+ *  inlined; static_bitsequence itself keeps the virtual calls for trees whose
+ *  nodes do not share a single type.
+ *
+ *  @author Carlos Bedregal
+ */
+template <class BS>
+struct BitseqOps{
+    typedef typename BS::index_type I;
+    typedef WTNodeT<I> Node;
+    static inline BS* bs(Node* node){ return static_cast<BS*>(node->bitseq); }
+    static inline I length(Node* node){ return bs(node)->BS::length(); }
+    static inline I rank0(Node* node, I i){ return bs(node)->BS::rank0(i); }
+    static inline I rank1(Node* node, I i){ return bs(node)->BS::rank1(i); }
+    static inline I select0(Node* node, I i){ return bs(node)->BS::select0(i); }
+    static inline I select1(Node* node, I i){ return bs(node)->BS::select1(i); }
+    static inline bool access(Node* node, I i){ return bs(node)->BS::access(i); }
+    static inline I select0_next(Node* node, I p, I r, I x){ return bs(node)->BS::select0_next(p,r,x); }
+    static inline I select1_next(Node* node, I p, I r, I x){ return bs(node)->BS::select1_next(p,r,x); }
+};
+
+template <>
+struct BitseqOps<static_bitsequence>{
+    typedef uint I;
+    typedef WTNode Node;
+    static inline uint length(WTNode* node){ return node->bitseq->length(); }
+    static inline uint rank0(WTNode* node, uint i){ return node->bitseq->rank0(i); }
+    static inline uint rank1(WTNode* node, uint i){ return node->bitseq->rank1(i); }
+    static inline uint select0(WTNode* node, uint i){ return node->bitseq->select0(i); }
+    static inline uint select1(WTNode* node, uint i){ return node->bitseq->select1(i); }
+    static inline bool access(WTNode* node, uint i){ return node->bitseq->access(i); }
+    static inline uint select0_next(WTNode* node, uint p, uint r, uint x){ return node->bitseq->select0_next(p,r,x); }
+    static inline uint select1_next(WTNode* node, uint p, uint r, uint x){ return node->bitseq->select1_next(p,r,x); }
+};
+
+/** Calls f with a null pointer of the bitsequence type of the nodes of a tree
+ *  of positions I, built with bitseqFlag type, so that the caller runs the
+ *  WTQuery (WTIterator) specialized for it: the types of bitseqFlag for
+ *  uint, and brw64 of 64-bit counters for 64-bit positions.
+ *
+ *  @author Carlos Bedregal
+ */
+template <class I>
+struct WTDispatch;
+
+template <>
+struct WTDispatch<uint>{
+    template <class F>
+    static inline auto run(int type, F f) -> decltype(f((static_bitsequence*)0)){
+        switch(type){
+            case RRR:
+                return f((static_bitsequence_rrr02*)0);
+            case RRRL:
+                return f((static_bitsequence_rrr02_light*)0);
+            case BRW64:
+                return f((static_bitsequence_brw64*)0);
+            case INTERLEAVED:
+                return f((static_bitsequence_interleaved*)0);
+            case RRR63:
+                return f((static_bitsequence_rrr63*)0);
+            case BRW:
+                return f((static_bitsequence_brw32*)0);
+            default:
+                return f((static_bitsequence*)0);
+        }
+    }
+};
+
+template <>
+struct WTDispatch<unsigned long long>{
+    template <class F>
+    static inline auto run(int type, F f) -> decltype(f((static_bitsequence_brw64_large*)0)){
+        return f((static_bitsequence_brw64_large*)0);
+    }
+};
+
+/** pi and piInv over a Hu-Tucker shaped wavelet tree [1] whose nodes all hold
+ *  bitsequences of type BS. Theorem1 dispatches to the specialization of the
+ *  type it was built (or loaded) with.
+ *
+ *  pi goes down with the zero count cached in each node, keeping the path in
+ *  a fixed array, and then climbs it with selects; recPi is the recursive
+ *  version, used when the path does not fit in WT_MAXDEPTH nodes. piLeaf
+ *  does only the upward half, from a leaf found by Theorem1's leaf index.
+ *  Positions are of the index_type of BS, the one of the nodes.
+ *
+ *  [1] J. Barbay and G. Navarro, Compressed Representation of Permutations,
+ *  and Applications.
+ *
+ *  @author Carlos Bedregal
+ */
+template <class BS>
+class WTQuery{
+    typedef BitseqOps<BS> Ops;
+    typedef typename Ops::Node Node;
+    typedef typename Ops::I I; //positions
+    typedef typename make_signed<I>::type Pos; //positions of the Theorem interface
+
+    public:
+    static I pi(Node* root, Pos i);
+    static I recPi(Node* node, Node* parent, Pos j);
+    static I piLeaf(Node* node, bool right, I j);
+    static I piInv(Node* root, Pos i);
+    static I recPiInv(Node* node, Pos i, Pos& p);
+    static void piInvRange(Node* root, Pos i, Pos j, Pos* out);
+    static void recPiInvRange(Node* node, I lo, I hi, Pos* src, Pos* dst, Pos* out, Pos p);
+};
+
+template <class BS>
+typename WTQuery<BS>::I WTQuery<BS>::pi(Node* root, Pos i){
+    Node* path[WT_MAXDEPTH];
+    bool side[WT_MAXDEPTH];
+    int depth=0;
+    I j=i+1;
+    Node* node=root;
+
+    //downward traversal to determine leaf v and offset j
+    for(;;){
+        bool right = node->zeros<j;
+        if(right) j-=node->zeros;
+        Node* child=node->children[right];
+        if(!child){
+            j = (right ? Ops::select1(node,j) : Ops::select0(node,j))+1;
+            break;
+        }
+        if(depth==WT_MAXDEPTH)
+            return recPi(root,0,i+1);
+        path[depth]=node;
+        side[depth++]=right;
+        node=child;
+    }
+
+    //upward traversal of the nodes in the path
+    while(depth--)
+        j = (side[depth] ? Ops::select1(path[depth],j) : Ops::select0(path[depth],j))+1;
+
+    return j-1;
+}
+
+/* j-th position (from 1) of the leaf hanging on the given side of node,
+ * climbing through the parent pointers up to the root */
+template <class BS>
+typename WTQuery<BS>::I WTQuery<BS>::piLeaf(Node* node, bool right, I j){
+    j = (right ? Ops::select1(node,j) : Ops::select0(node,j))+1;
+    for(Node* parent=node->parent; parent; node=parent, parent=node->parent)
+        j = (node==parent->children[0] ? Ops::select0(parent,j) : Ops::select1(parent,j))+1;
+    return j-1;
+}
+
+template <class BS>
+typename WTQuery<BS>::I WTQuery<BS>::recPi(Node* node, Node* parent, Pos j){
+    #ifdef DEBUG
+        int s=Ops::length(node);
+        cout<<"\tDOWN: nodo: "<<node->size<<", s: "<<s<<", j: "<<j<<", rank0(B,s-1): "<<Ops::rank0(node,s-1)<<endl;
+    #endif //DEBUG
+
+    //downward traversal to determine leaf v and offset j
+    //a) go down to the left
+    I zeros=node->zeros;
+    if(zeros >= (I)j){
+        if(!node->children[0])
+            j=Ops::select0(node,j)+1;
+        else
+            j=recPi(node->children[0],node,j);
+    }
+    //b) go down to the right
+    else{
+        j=j-zeros;
+        if(!node->children[1])
+            j=Ops::select1(node,j)+1;
+        else
+            j=recPi(node->children[1],node,j);
+    }
+
+    #ifdef DEBUG
+        cout<<"\tUP: nodo: "<<node->size<<", s: "<<s<<", j: "<<j;
+    #endif //DEBUG
+
+    //we've reach the root
+    if(!parent)
+        return j-1;
+
+    //upward traversal of nodes in the recursion stack
+    //a) left child of parent
+    if(node==parent->children[0])
+        j=Ops::select0(parent,j);
+    //b) right child of parent
+    else
+        j=Ops::select1(parent,j);
+
+    return ++j;
+}
+
+template <class BS>
+typename WTQuery<BS>::I WTQuery<BS>::piInv(Node* root, Pos i){
+    Pos p=0;
+    for(Node* node=root; node; ){
+        //B[i]=1, go down to the right
+        if(Ops::access(node,i)){
+            p+=node->zeros;
+            i=Ops::rank1(node,i)-1;
+            node=node->children[1];
+        }
+        //B[i]=0, go down to the left
+        else{
+            i=Ops::rank0(node,i)-1;
+            node=node->children[0];
+        }
+    }
+    return p+i;
+}
+
+template <class BS>
+typename WTQuery<BS>::I WTQuery<BS>::recPiInv(Node* node, Pos i, Pos& p){
+    //is leaf?
+    if(!node)
+        return p+i;
+
+    #ifdef DEBUG
+        cout<<"\tnodo: "<<node->size<<", i: "<<i<<", p: "<<p<<", B[i]: "<<Ops::access(node,i)<<endl;
+    #endif //DEBUG
+
+    //B[i]=1, go down to the right
+    if(Ops::access(node,i)){
+        p=p+node->zeros;
+        return recPiInv(node->children[1],Ops::rank1(node,i)-1,p);
+    }
+    //B[i]=0, go down to the left
+    else{
+        return recPiInv(node->children[0],Ops::rank0(node,i)-1,p);
+    }
+}
+
+/* piInv of the values i..j into out[0..j-i]. They are consecutive positions
+ * of the root, and the positions of a node that go to each child are again
+ * consecutive there, so each node visited pays two ranks and a scan of its
+ * bits in the range, instead of an access and a rank per value */
+template <class BS>
+void WTQuery<BS>::piInvRange(Node* root, Pos i, Pos j, Pos* out){
+    if(i>j) return;
+    Pos* slots = new Pos[2*(j-i+1)];
+    for(Pos k=0; k<=j-i; k++) slots[k]=k;
+    recPiInvRange(root,i,j,slots,slots+j-i+1,out,0);
+    delete[]slots;
+}
+
+/* src[k] is the index in out of position lo+k of node, whose first leaf
+ * starts at position p of the permutation. The children get their slots in
+ * dst, and use src as their own dst */
+template <class BS>
+void WTQuery<BS>::recPiInvRange(Node* node, I lo, I hi, Pos* src, Pos* dst, Pos* out, Pos p){
+    //leaf: consecutive positions of the run
+    if(!node){
+        for(I k=0; k<=hi-lo; k++)
+            out[src[k]] = p+lo+k;
+        return;
+    }
+    I r0 = lo ? Ops::rank0(node,lo-1) : 0;
+    I nl = Ops::rank0(node,hi)-r0, nr = hi-lo+1-nl;
+    Pos* child[2] = {dst, dst+nl};
+    for(I q=lo; q<=hi; q++)
+        *child[Ops::access(node,q)]++ = src[q-lo];
+    if(nl)
+        recPiInvRange(node->children[0],r0,r0+nl-1,dst,src,out,p);
+    if(nr)
+        recPiInvRange(node->children[1],lo-r0,lo-r0+nr-1,dst+nl,src+nl,out,p+node->zeros);
+}
+
+/** Sequential pi over the tree of WTQuery. Consecutive positions of a run
+ *  are consecutive offsets in its leaf, so their images in every node of the
+ *  path are increasing: the iterator keeps, for each level, the position in
+ *  the node and the rank of the side taken, and moves them forward with
+ *  select0_next/select1_next, which scan from the previous position on the
+ *  bitsequences that can (brw32, brw64) before resorting to a select. Only
+ *  the first position of each run pays a full traversal.
+ *
+ *  @author Carlos Bedregal
+ */
+template <class BS>
+class WTIterator : public PiIteratorT<typename BitseqOps<BS>::I>{
+    typedef BitseqOps<BS> Ops;
+    typedef typename Ops::Node Node;
+    typedef typename Ops::I I;
+    typedef typename make_signed<I>::type Pos;
+
+    Node* root;
+    I len; //positions in the tree
+    I i; //current position
+    Node* path[WT_MAXDEPTH]; //nodes from the root to the parent of the leaf
+    bool side[WT_MAXDEPTH]; //child taken at each node
+    I pos[WT_MAXDEPTH]; //position of the current element in each node
+    I cnt[WT_MAXDEPTH]; //bits equal to side up to pos
+    int depth; //nodes in path, -1 if the tree is deeper than WT_MAXDEPTH
+    I left; //positions of the current run after i
+
+    public:
+    WTIterator(Node* root, I len, Pos i);
+    bool hasNext(){ return i<len; }
+    I next();
+
+    private:
+    void seek();
+    I advance(int d, I x);
+};
+
+template <class BS>
+WTIterator<BS>::WTIterator(Node* root, I len, Pos i){
+    this->root=root;
+    this->len=len;
+    this->i=i;
+    depth=0;
+    left=0;
+}
+
+/* full traversal for the first position of a run */
+template <class BS>
+void WTIterator<BS>::seek(){
+    I j=i+1;
+    Node* node=root;
+    for(depth=0;;){
+        bool right = node->zeros<j;
+        if(right) j-=node->zeros;
+        if(depth==WT_MAXDEPTH){ depth=-1; return; }
+        path[depth]=node;
+        side[depth++]=right;
+        if(!node->children[right]) break;
+        node=node->children[right];
+    }
+    left = (side[depth-1] ? Ops::length(node)-node->zeros : node->zeros) - j;
+    for(int d=depth-1; d>=0; d--){
+        pos[d] = side[d] ? Ops::select1(path[d],j) : Ops::select0(path[d],j);
+        cnt[d] = j;
+        j = pos[d]+1;
+    }
+}
+
+/* position of the x-th bit equal to side[d] in path[d], x>cnt[d] */
+template <class BS>
+typename WTIterator<BS>::I WTIterator<BS>::advance(int d, I x){
+    I q = side[d] ? Ops::select1_next(path[d],pos[d],cnt[d],x)
+                     : Ops::select0_next(path[d],pos[d],cnt[d],x);
+    cnt[d]=x;
+    return pos[d]=q;
+}
+
+template <class BS>
+typename WTIterator<BS>::I WTIterator<BS>::next(){
+    if(depth<0)
+        return WTQuery<BS>::pi(root,i++);
+    if(!left){
+        seek();
+        if(depth<0)
+            return WTQuery<BS>::pi(root,i++);
+    }
+    else{
+        left--;
+        I x=cnt[depth-1]+1;
+        for(int d=depth-1; d>=0; d--)
+            x=advance(d,x)+1;
+    }
+    i++;
+    return pos[0];
+}
+
+#endif // WTQUERY_H_INCLUDED